@@ -0,0 +1,49 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace bench {
+
+/**
+ * Keeps value from being optimized away.
+ */
+template <class T>
+inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Runs f(i) for i in [0, repetitions), after a warm up pass over at most
+ * repetitions / 10 of them.
+ * @return Mean nanoseconds per call.
+ */
+template <class F>
+double measure(size_t repetitions, F f) {
+  for (size_t i = 0; i < repetitions / 10; i++) {
+    f(i);
+  }
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repetitions; i++) {
+    f(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() / repetitions;
+}
+
+/**
+ * Prints a result line: name, size, then nanoseconds per call.
+ */
+inline void report(const std::string& name, size_t size, double nanoseconds) {
+  std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << size
+            << std::setw(14) << std::fixed << std::setprecision(1) << nanoseconds << " ns" << std::endl;
+}
+
+}  // namespace bench
@@ -0,0 +1,78 @@
+//
+// Created by agent on 17/10/26.
+//
+
+// Time to index lookups of Metric: the linear scans they replaced, binary
+// search, and WindowCursor seeking windows in time order.
+
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "metric.h"
+
+namespace {
+
+// The scans getIndexAfter and getIndexBefore used to make.
+size_t scanIndexAfter(const MetricData& data, app::time time) {
+  size_t index = 0;
+  while (index < data.size() && data.timeAt(index) < time) {
+    index++;
+  }
+  return index;
+}
+
+size_t scanIndexBefore(const MetricData& data, app::time time) {
+  size_t index = data.size() - 1;
+  while (index > 0 && data.timeAt(index) > time) {
+    index--;
+  }
+  return index;
+}
+
+std::shared_ptr<Metric> createMetric(size_t pointCount) {
+  // Irregular, so lookups search the timestamp column.
+  std::vector<app::time> times(pointCount);
+  std::vector<app::value> values(pointCount);
+  for (size_t i = 0; i < pointCount; i++) {
+    times[i] = 1000000 + 60 * i + (i % 7);
+    values[i] = static_cast<app::value>(i % 100);
+  }
+  return std::make_shared<Metric>("bench", MetricData(std::move(times), std::move(values)), 0);
+}
+
+}  // namespace
+
+int main() {
+  const app::time WINDOW = 3000;
+  for (size_t pointCount : {1000, 100000, 1000000}) {
+    auto metric = createMetric(pointCount);
+    const MetricData& data = metric->getData();
+    app::time timeBegin = metric->getTimeBegin();
+    app::time span = metric->getTimeEnd() - timeBegin - WINDOW;
+    // Scattered windows, as the uniform sampler draws them.
+    auto scattered = [&](size_t i) {
+      return timeBegin + static_cast<app::time>((i * 2654435761ULL) % span);
+    };
+
+    size_t scanRepetitions = pointCount >= 1000000 ? 20 : 200;
+    bench::report("linear scan", pointCount, bench::measure(scanRepetitions, [&](size_t i) {
+      app::time t = scattered(i);
+      bench::doNotOptimize(scanIndexAfter(data, t) + scanIndexBefore(data, t + WINDOW));
+    }));
+    bench::report("binary search", pointCount, bench::measure(100000, [&](size_t i) {
+      app::time t = scattered(i);
+      bench::doNotOptimize(metric->getIndexAfter(t) + metric->getIndexBefore(t + WINDOW));
+    }));
+
+    // Windows moving forward by a minute, as a caller walking the series does.
+    Metric::WindowCursor cursor(metric);
+    size_t windowCount = span / 60;
+    bench::report("cursor, in time order", pointCount, bench::measure(100000, [&](size_t i) {
+      app::time t = timeBegin + 60 * (i % windowCount);
+      cursor.seek(t, t + WINDOW);
+      bench::doNotOptimize(cursor.getIndexAfter() + cursor.getIndexBefore());
+    }));
+  }
+  return 0;
+}
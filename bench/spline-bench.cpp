@@ -0,0 +1,69 @@
+//
+// Created by agent on 17/10/26.
+//
+
+// Fitting a window's natural cubic spline and sampling it at PATTERN_SIZE
+// times: tk::spline (lib/spline.h), as getPattern used to, against CubicSpline.
+// That both give the same values is tested in test/src/cubic-spline-test.cpp.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "bench.h"
+#include "cubic-spline.h"
+#include "declares.h"
+#include "spline.h"
+
+namespace {
+
+MetricData createData(size_t pointCount) {
+  std::vector<app::time> times(pointCount);
+  std::vector<app::value> values(pointCount);
+  for (size_t i = 0; i < pointCount; i++) {
+    times[i] = 1000000 + 60 * i + (i % 7);
+    values[i] = std::sin(i * 0.1) * 100 + (i % 13);
+  }
+  return MetricData(std::move(times), std::move(values));
+}
+
+// What getPattern did for a window: copy it out, fit, then sample.
+void interpolateTk(const MetricData& data, double timeBegin, double increment, double* out) {
+  std::vector<double> x;
+  std::vector<double> y;
+  for (size_t i = 0; i < data.size(); i++) {
+    x.push_back(static_cast<double>(data.timeAt(i)));
+  }
+  for (size_t i = 0; i < data.size(); i++) {
+    y.push_back(data.valueAt(i));
+  }
+  tk::spline spline;
+  spline.set_points(x, y);
+  for (size_t i = 0; i < app::PATTERN_SIZE; i++) {
+    out[i] = spline(timeBegin + increment * i);
+  }
+}
+
+}  // namespace
+
+int main() {
+  for (size_t pointCount : {10, 50, 100, 500, 1000, 5000}) {
+    MetricData data = createData(pointCount);
+    double timeBegin = static_cast<double>(data.timeAt(0));
+    double increment = static_cast<double>(data.timeAt(pointCount - 1) - data.timeAt(0)) / app::PATTERN_SIZE;
+    size_t repetitions = std::max<size_t>(200, 2000000 / pointCount);
+
+    double expected[app::PATTERN_SIZE];
+    double actual[app::PATTERN_SIZE];
+
+    bench::report("tk::spline", pointCount, bench::measure(repetitions, [&](size_t) {
+      interpolateTk(data, timeBegin, increment, expected);
+      bench::doNotOptimize(expected);
+    }));
+    bench::report("CubicSpline::interpolate", pointCount, bench::measure(repetitions, [&](size_t) {
+      CubicSpline::interpolate(data, 0, pointCount, timeBegin, increment, app::PATTERN_SIZE, actual);
+      bench::doNotOptimize(actual);
+    }));
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+//
+// Created by agent on 17/10/26.
+//
+
+// Tile coding a pattern's state-action: rl's TileCodeMurMur over the parameter
+// vector, as QLearningGD is given it, against PatternTileCode.
+
+#include <random>
+#include <vector>
+
+#include <rl>
+
+#include "bench.h"
+#include "pattern-distance.h"
+#include "tile-coding.h"
+
+int main() {
+  const size_t PATTERN_COUNT = 4096;
+  const size_t METRIC_COUNT = 11043;
+  const size_t TABLE_SIZE = 1 << 24;
+
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_int_distribution<size_t> metricIndex(0, METRIC_COUNT - 1);
+
+  // State-actions as getGradientDescentParameters lays them out, and the same
+  // y values padded as PatternFeatures holds them.
+  const size_t PADDED_SIZE = app::PATTERN_TILE_CODE::PADDED_SIZE;
+  std::vector<rl::floatVector> parameters(PATTERN_COUNT);
+  std::vector<float> y(PATTERN_COUNT * PADDED_SIZE, 0.0f);
+  std::vector<size_t> metricIndices(PATTERN_COUNT);
+  for (size_t p = 0; p < PATTERN_COUNT; p++) {
+    for (size_t i = 0; i < app::PATTERN_SIZE; i++) {
+      y[p * PADDED_SIZE + i] = unit(generator);
+      parameters[p].push_back(y[p * PADDED_SIZE + i]);
+    }
+    metricIndices[p] = metricIndex(generator);
+    parameters[p].push_back(static_cast<rl::FLOAT>(metricIndices[p]));
+    parameters[p].push_back(0.0f);  // The action.
+  }
+
+  std::vector<rl::coding::DimensionInfo<rl::FLOAT>> dimensionInfo;
+  for (size_t i = 0; i < app::PATTERN_SIZE; i++) {
+    dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10));
+  }
+  dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, METRIC_COUNT - 1.0F, METRIC_COUNT, 0.0F));
+  dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 0.0F, 1, 0.0F));
+  rl::coding::TileCodeMurMur murMur(dimensionInfo, app::TILING_COUNT, TABLE_SIZE);
+  app::PATTERN_TILE_CODE patternTileCode(METRIC_COUNT, TABLE_SIZE);
+
+  const size_t REPETITIONS = 1000000;
+  bench::report("TileCodeMurMur", PATTERN_COUNT, bench::measure(REPETITIONS, [&](size_t i) {
+    bench::doNotOptimize(murMur.getFeatureVector(parameters[i % PATTERN_COUNT]));
+  }));
+  bench::report("PatternTileCode::getFeatureVector", PATTERN_COUNT, bench::measure(REPETITIONS, [&](size_t i) {
+    bench::doNotOptimize(patternTileCode.getFeatureVector(parameters[i % PATTERN_COUNT]));
+  }));
+  size_t features[app::TILING_COUNT];
+  bench::report("PatternTileCode::getFeatures", PATTERN_COUNT, bench::measure(REPETITIONS, [&](size_t i) {
+    size_t p = i % PATTERN_COUNT;
+    patternTileCode.getFeatures(y.data() + p * PADDED_SIZE, metricIndices[p], features);
+    bench::doNotOptimize(features);
+  }));
+  return 0;
+}
@@ -0,0 +1,140 @@
+//
+// Created by agent on 17/10/26.
+//
+
+// Training time against the number of threads: the qLearningGD learner (rl's
+// agent), trained one metric at a time, then the td0 learner's QModel on 1, 2, 4,
+// ... threads up to the number of cores (or argv[1] threads). Speedups are
+// relative to the QModel on 1 thread. The two learn different models, see
+// app::Learner, so only the QModel's rows compare thread counts. Usage: ./bench/train-bench [maxThreads [metricCount [iterationCount]]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <rl>
+
+#include "app.h"
+#include "metric.h"
+#include "q-model.h"
+#include "task-scheduler.h"
+#include "tile-coding.h"
+
+namespace {
+
+const app::time TIME_BEGIN = 1474100000;
+const app::time STEP = 60;
+const size_t POINT_COUNT = 1440;  // A day of minutes.
+
+/**
+ * Random walks, so patterns differ from metric to metric and window to window.
+ */
+std::vector<std::shared_ptr<Metric>> createMetrics(size_t metricCount) {
+  std::mt19937 generator(42);
+  std::normal_distribution<double> step(0.0, 1.0);
+  std::vector<std::shared_ptr<Metric>> metrics;
+  for (size_t m = 0; m < metricCount; m++) {
+    std::vector<app::time> times(POINT_COUNT);
+    std::vector<app::value> values(POINT_COUNT);
+    double value = 0;
+    for (size_t i = 0; i < POINT_COUNT; i++) {
+      times[i] = TIME_BEGIN + i * STEP;
+      value += step(generator);
+      values[i] = value;
+    }
+    metrics.push_back(std::make_shared<Metric>(
+        "bench.metric." + std::to_string(m), MetricData(std::move(times), std::move(values)), m));
+  }
+  return metrics;
+}
+
+/**
+ * @return Seconds spent in train(), with its progress output discarded.
+ */
+template <class TRAIN>
+double measure(TRAIN train) {
+  std::ostringstream discarded;
+  auto coutBuffer = std::cout.rdbuf(discarded.rdbuf());
+  auto begin = std::chrono::steady_clock::now();
+  train();
+  auto end = std::chrono::steady_clock::now();
+  std::cout.rdbuf(coutBuffer);
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+void report(const std::string& name, size_t threadCount, double seconds, double referenceSeconds) {
+  std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << threadCount
+            << std::setw(12) << std::fixed << std::setprecision(3) << seconds << " s"
+            << std::setw(10) << std::setprecision(2) << referenceSeconds / seconds << "x" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t maxThreadCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) :
+      std::max(1U, std::thread::hardware_concurrency());
+  size_t metricCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+  size_t iterationCount = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 50;
+
+  auto metrics = createMetrics(metricCount);
+  app::time goalTimeBegin = TIME_BEGIN + 600 * STEP;
+  auto goalState = Metric::getPattern<app::PATTERN_SIZE>(metrics[0], goalTimeBegin, goalTimeBegin + 30 * STEP);
+  auto minMaxTime = Metric::getMinMaxTime(metrics);
+
+  size_t metricDimension = app::getMetricDimension(metrics);
+  auto tileCode = app::createTileCode(metricDimension, app::getTableSize(metricDimension, 1024));
+  const rl::FLOAT STEP_SIZE = 0.1F;
+  const rl::FLOAT DISCOUNT_RATE = 0.9F;
+  const rl::FLOAT INITIAL_REWARD = -1000000.0F;
+
+  app::TrainOptions options;
+  options.interpolation = app::Interpolation::METRIC_SPLINE;
+  options.seed = 42;
+
+  // Warm up: fits every metric's spline, which is kept for the measured runs.
+  {
+    QModel model(*tileCode, STEP_SIZE, DISCOUNT_RATE, INITIAL_REWARD);
+    measure([&]() {
+      app::train(iterationCount, metrics, goalState, model, minMaxTime.first, minMaxTime.second, options);
+    });
+  }
+
+  std::cout << metricCount << " metrics, " << iterationCount << " iterations, "
+            << std::thread::hardware_concurrency() << " core(s)." << std::endl;
+  std::cout << std::left << std::setw(12) << "model" << std::right << std::setw(8) << "threads"
+            << std::setw(14) << "time" << std::setw(11) << "speedup" << std::endl;
+
+  // The QModel on 1 thread, the reference the speedups are relative to.
+  double referenceSeconds = 0;
+  for (size_t threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+    TaskScheduler scheduler(threadCount);
+    app::TrainOptions threadOptions = options;
+    threadOptions.scheduler = &scheduler;
+    QModel model(*tileCode, STEP_SIZE, DISCOUNT_RATE, INITIAL_REWARD);
+    double seconds = measure([&]() {
+      app::train(iterationCount, metrics, goalState, model, minMaxTime.first, minMaxTime.second, threadOptions);
+    });
+    if (threadCount == 1) {
+      referenceSeconds = seconds;
+
+      rl::policy::EpsilonGreedy<rl::floatVector, rl::floatVector> policy(1.0F);
+      rl::algorithm::QLearningGD qLearning(*tileCode, STEP_SIZE, DISCOUNT_RATE, app::TRACE_DECAY, policy);
+      rl::spActionSet<rl::floatVector> actions({ app::goalAction });
+      auto actionSet = rl::ActionSet<rl::floatVector>(actions);
+      qLearning.setDefaultStateActionValue(INITIAL_REWARD);
+      rl::AgentSupervised<rl::floatVector, rl::floatVector> agent(actionSet, qLearning);
+      report("rl agent", 1, measure([&]() {
+        app::train(iterationCount, metrics, goalState, agent, minMaxTime.first, minMaxTime.second, options);
+      }), referenceSeconds);
+    }
+    report("QModel", threadCount, seconds, referenceSeconds);
+  }
+
+  return 0;
+}
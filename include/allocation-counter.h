@@ -0,0 +1,19 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace app {
+
+/**
+ * Counts heap allocations, to check that hot loops don't allocate. Built with
+ * COUNT_ALLOCATIONS defined (cmake -DCOUNT_ALLOCATIONS=ON), the global operator
+ * new is replaced by one that counts its calls; otherwise nothing is counted.
+ * @return Number of operator new calls so far, by every thread.
+ */
+size_t getAllocationCount();
+
+}  // namespace app
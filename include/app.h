@@ -6,29 +6,364 @@
 
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <functional>
 
 #include "declares.h"
+#include "interpolation.h"
+#include "pattern-status.h"
 #include "plot-pattern.h"
+#include "window-sampler.h"
+
+class MetricGrid;
+class ModelStore;
+class QModel;
+class TaskScheduler;
+class TrainCheckpoint;
 
 namespace app {
 
 /**
- * Training the agent's model to predict the goal Metric. Basically giving the agent a way to tell
+ * The model app::train trains, the config's "learner".
+ */
+enum class Learner {
+  // rl's QLearningGD agent, Q(lambda) with eligibility traces decaying by
+  // TRACE_DECAY. Trained one update after the other on the calling thread. The default.
+  Q_LEARNING_GD,
+  // QModel, one step Q-learning (TD(0), no traces). Trained on many threads,
+  // sharded by metric, and needed by checkpoints, early stopping, successive
+  // halving, the reports, saved models and sparse or half precision weights.
+  TD0
+};
+
+// Q_LEARNING_GD's lambda.
+const rl::FLOAT TRACE_DECAY = 0.9F;
+
+/**
+ * @param name "qLearningGD" or "td0".
+ * @return The learner of that name.
+ * @throw std::domain_error if the name is unknown.
+ */
+Learner parseLearner(const std::string &name);
+
+/**
+ * Stops training once the ranking of the scored patterns stops changing: at every
+ * checkpoint, the patterns are scored, and training stops after the Kendall tau
+ * between the top ranked patterns of consecutive checkpoints was at least
+ * threshold patience times in a row.
+ */
+struct EarlyStopping {
+  // The patterns ranked at each checkpoint, such as the ones scored for the result.
+  // Early stopping is off if not given.
+  const vector<rl::spState<STATE>> *patterns = nullptr;
+
+  // Iterations between checkpoints.
+  size_t checkpointInterval = 100;
+
+  // Number of top ranked patterns compared.
+  size_t topK = 100;
+
+  // Kendall tau, in [-1, 1], above which the ranking is considered stable.
+  double threshold = 0.95;
+
+  // Number of stable checkpoints in a row needed to stop.
+  size_t patience = 3;
+};
+
+/**
+ * Spends the iterations on the metrics that look related to the goal: the
+ * iterations are split in rounds, and after each round but the last, only the
+ * keepFraction best valued metrics (over the goal pattern's time frame) are
+ * trained further. The others keep the value they had.
+ */
+struct SuccessiveHalving {
+  // Number of rounds. Every metric is trained on every window if at most 1.
+  size_t rounds = 0;
+
+  // Fraction, in (0, 1], of the metrics kept after each round.
+  double keepFraction = 0.5;
+
+  // Never keep fewer metrics than this.
+  size_t minMetrics = 50;
+};
+
+/**
+ * Optional parameters of app::train.
+ */
+struct TrainOptions {
+  // How patterns are interpolated from the metrics' datapoints.
+  Interpolation interpolation = Interpolation::SPLINE;
+
+  // If given, metrics resampled onto a time grid (row i is metrics[i]) that patterns are
+  // read from instead of being interpolated. Must contain goalState's metric.
+  const MetricGrid *grid = nullptr;
+
+  // If given, the metrics are trained on its workers. Otherwise on the calling thread.
+  // Either way, the trained model is the same.
+  TaskScheduler *scheduler = nullptr;
+
+  // Selects the sampled windows, see CounterRandom.
+  uint64_t seed = 0;
+
+  // How the windows' start times are spread over [minMetricTime, maxMetricTime].
+  Sampler sampler = Sampler::UNIFORM;
+
+  // If checkpointInterval > 0, checkpoint is called after every checkpointInterval
+  // iterations (sampled windows, including skipped ones) and after the last one,
+  // with the number of iterations done. Training stops if it returns false.
+  size_t checkpointInterval = 0;
+  std::function<bool(size_t iterationsDone)> checkpoint;
+
+  // If its patterns are given, checkpointInterval is replaced by the early stopping
+  // one, and checkpoint (if any) is called at the early stopping checkpoints.
+  EarlyStopping earlyStopping;
+
+  // See SuccessiveHalving.
+  SuccessiveHalving successiveHalving;
+
+  // If not empty, a TrainCheckpoint is written to this file every
+  // checkpointFileInterval iterations and when training ends, on a background thread.
+  std::string checkpointFile;
+  size_t checkpointFileInterval = 100;
+
+  // If given, training continues from this checkpoint. The model must have been
+  // restored from it, and the other options and parameters must be the ones it
+  // was written with. Early stopping starts over.
+  const TrainCheckpoint *resume = nullptr;
+};
+
+/**
+ * What app::train did.
+ */
+struct TrainSummary {
+  // Number of iterations done, iterationCount unless training stopped early.
+  size_t iterations = 0;
+
+  // Whether training was stopped, by early stopping or by TrainOptions::checkpoint.
+  bool stoppedEarly = false;
+
+  // Number of metric updates (pattern extractions), at most iterations * metrics.
+  size_t updateCount = 0;
+
+  // Indices of the metrics still trained when training ended, increasing. Every
+  // metric unless successive halving pruned some.
+  vector<size_t> activeMetrics;
+
+  // Statuses of the training windows' pattern extractions, one per metric trained
+  // in a window. The rejected ones are not updates.
+  app::PatternStatusCounts patterns;
+
+  // Statuses of the goal metric's pattern extractions, one per sampled window. The
+  // rejected windows are skipped.
+  app::PatternStatusCounts goalPatterns;
+
+  // Training time.
+  double seconds = 0;
+
+  // Heap allocations while training on the windows after the first one, other than
+  // checkpoints and successive halving's pruning. 0 for a QModel with the pattern
+  // tile coder but for growing buffers (sparse weights, the spline interpolation's
+  // scratch). rl's agent, and TileCodeMurMur, allocate on every update. Only counted
+  // when built with COUNT_ALLOCATIONS, see app::getAllocationCount.
+  size_t steadyStateAllocations = 0;
+};
+
+/**
+ * Training the model to predict the goal Metric. Basically giving the model a way to tell
  * what set of metrics will likely lead to goalState A.
  *
  * @param iterationCount Number of iteration. The higher the better the closer is the resulting model to reality.
  * @param metrics A list of graphite metrics.
  * @param goalState A shared_ptr to a plot-pattern.
- * @param agent The agent that will be trained/
+ * @param model The model that will be trained.
  * @param minMetricTime Minimum time to train (unix time stamp).
  * @param maxMetricTime Maximum time to train (unix time stamp).
+ * @param options See TrainOptions.
+ * @return See TrainSummary.
+ */
+TrainSummary train(size_t iterationCount,
+                   const vector<std::shared_ptr<Metric>> &metrics,
+                   rl::spState<STATE> &goalState,
+                   QModel &model,
+                   size_t minMetricTime,
+                   size_t maxMetricTime,
+                   const TrainOptions &options = TrainOptions());
+
+/**
+ * Same as train(..., QModel&, ...), but trains rl's agent (Learner::Q_LEARNING_GD),
+ * one metric at a time on the calling thread. Its QLearningGD keeps eligibility
+ * traces, so every update depends on the one before it and can't be made
+ * concurrently. Its values, and so the ranking, differ from a QModel's. rl's API takes
+ * states as shared_ptrs and tile codes them into new vectors, so every update
+ * allocates.
+ *
+ * @param agent The agent that will be trained.
+ * @param options Only the interpolation, grid, seed and sampler are used.
+ * @throw std::invalid_argument if options ask for checkpoints, early stopping,
+ *        successive halving, a checkpoint file or resuming, which need a QModel.
+ */
+TrainSummary train(size_t iterationCount,
+                   const vector<std::shared_ptr<Metric>> &metrics,
+                   rl::spState<STATE> &goalState,
+                   rl::AgentSupervised<rl::floatVector, rl::floatVector> &agent,
+                   size_t minMetricTime,
+                   size_t maxMetricTime,
+                   const TrainOptions &options = TrainOptions());
+
+/**
+ * Optional parameters of app::screenMetrics.
+ */
+struct ScreenOptions {
+  // Number of sampled windows the metrics are compared to the goal metric over.
+  size_t windowCount = 20;
+
+  // If > 0, keep at most the topK closest metrics.
+  size_t topK = 0;
+
+  // If >= 0, keep only the metrics whose mean absolute area is at most maxArea.
+  double maxArea = -1;
+};
+
+/**
+ * Cheap pre-screen of the metrics before training: compares every metric to the
+ * goal metric over a sample of windows, by the absolute area between their
+ * normalized patterns (PlotPattern::getAbsoluteArea, the distance the training
+ * reward is based on), and keeps the closest ones on average. A window's
+ * patterns are compared in one PatternDistance pass per block of metrics.
+ *
+ * @param metrics A list of graphite metrics.
+ * @param goalState The goal pattern, its metric is always kept.
+ * @param minMetricTime Minimum window time (unix time stamp).
+ * @param maxMetricTime Maximum window time (unix time stamp).
+ * @param screenOptions See ScreenOptions.
+ * @param options The interpolation, grid, scheduler, sampler and seed to use, see TrainOptions.
+ * @return Indices of the kept metrics, in increasing order.
+ */
+vector<size_t> screenMetrics(const vector<std::shared_ptr<Metric>> &metrics,
+                             const rl::spState<STATE> &goalState,
+                             size_t minMetricTime,
+                             size_t maxMetricTime,
+                             const ScreenOptions &screenOptions,
+                             const TrainOptions &options = TrainOptions());
+
+/**
+ * @param patterns The scored patterns.
+ * @param model A trained model.
+ * @param scheduler If given, patterns are scored on its workers. Otherwise on the calling thread.
+ * @return The model's value of each pattern leading to the goal.
+ */
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        const QModel &model,
+                        TaskScheduler *scheduler = nullptr);
+
+/**
+ * Same as score(patterns, QModel), with a saved model.
+ */
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        const ModelStore &model,
+                        TaskScheduler *scheduler = nullptr);
+
+/**
+ * Same as score(patterns, QModel), with the agent's QLearningGD, on the calling thread.
+ */
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        rl::algorithm::QLearningGD &qLearning);
+
+/**
+ * Ranks the metrics over a new window with a saved model, without training, and
+ * serializes the result like a trained run does (see app::serializeResult).
+ *
+ * @param model The saved model (see ModelStore).
+ * @param metrics The metrics to rank, matched to the trained ones by name.
+ *                Metrics the model wasn't trained with are skipped.
+ * @param goalMetric Name of the goal metric.
+ * @param timeBegin Beginning of the window (unix time stamp).
+ * @param timeEnd End of the window (unix time stamp).
+ * @param interpolation How patterns are interpolated from the metrics' datapoints.
+ * @param scheduler If given, patterns are extracted and scored on its workers.
+ * @param resultFile The file to which the result will be dumped.
+ * @throw std::runtime_error if the goal metric has no pattern in the window.
+ */
+void scoreWithModel(const ModelStore &model,
+                    const vector<std::shared_ptr<Metric>> &metrics,
+                    const string &goalMetric,
+                    app::time timeBegin,
+                    app::time timeEnd,
+                    Interpolation interpolation,
+                    TaskScheduler *scheduler,
+                    const string &resultFile);
+
+/**
+ * Trains the model once with each sampler (see TrainOptions::sampler), scoring the
+ * patterns at checkpointCount checkpoints, and writes how fast each sampler's
+ * ranking settles to a json file: at each checkpoint, the Kendall tau and top k
+ * overlap with the sampler's final ranking and with the consensus ranking (mean
+ * of the samplers' final scores), and the largest gap between the sampler's
+ * window starts. The model is reset before and after.
+ *
+ * @param reportFile The json file to write.
+ * @param patterns The scored patterns.
+ * @param checkpointCount Number of checkpoints per sampler.
+ * @param topK Number of top ranked metrics compared.
+ * @param options The training options, other than the sampler and checkpoints.
+ * See app::train for the other parameters.
+ */
+void writeConvergenceReport(const string &reportFile,
+                            size_t iterationCount,
+                            const vector<std::shared_ptr<Metric>> &metrics,
+                            rl::spState<STATE> &goalState,
+                            const vector<rl::spState<STATE>> &patterns,
+                            QModel &model,
+                            size_t minMetricTime,
+                            size_t maxMetricTime,
+                            size_t checkpointCount,
+                            size_t topK,
+                            const TrainOptions &options);
+
+/**
+ * Trains a full precision model and a quantized one (see QModel::Storage::HALF)
+ * the same way, and writes how the quantized model's ranking of the patterns
+ * compares to the full precision one's to a json file: the Kendall tau and
+ * overlap of the top k, the largest and mean score difference, and each model's
+ * memory and training time. Both models are reset before and after.
+ *
+ * @param reportFile The json file to write.
+ * @param patterns The scored patterns.
+ * @param referenceModel The full precision model.
+ * @param quantizedModel The quantized model, same tile coding and parameters.
+ * @param topK Number of top ranked metrics compared.
+ * @param options The training options, other than checkpoints.
+ * See app::train for the other parameters.
  */
-void train(size_t iterationCount,
-           const vector<std::shared_ptr<Metric>> &metrics,
-           rl::spState<STATE> &goalState,
-           rl::AgentSupervised<rl::floatVector, rl::floatVector> &agent,
-           size_t minMetricTime,
-           size_t maxMetricTime);
+void writeQuantizationReport(const string &reportFile,
+                             size_t iterationCount,
+                             const vector<std::shared_ptr<Metric>> &metrics,
+                             rl::spState<STATE> &goalState,
+                             const vector<rl::spState<STATE>> &patterns,
+                             QModel &referenceModel,
+                             QModel &quantizedModel,
+                             size_t minMetricTime,
+                             size_t maxMetricTime,
+                             size_t topK,
+                             const TrainOptions &options);
+
+/**
+ * Loads metrics from either a graphite json export or a binary MetricStore
+ * (see app::convertMetrics).
+ * @param metricsFile The file to load the metrics from.
+ * @return The loaded metrics.
+ * @throw std::exception if the file can't be opened or parsed.
+ */
+vector<std::shared_ptr<Metric>> loadMetrics(const string &metricsFile);
+
+/**
+ * Converts a graphite json export into a binary MetricStore, which loads
+ * without parsing.
+ * @param jsonFile The graphite json export.
+ * @param storeFile The MetricStore file to write.
+ * @throw std::exception if either file can't be opened, or the json can't be parsed.
+ */
+void convertMetrics(const string &jsonFile, const string &storeFile);
 
 /**
  * Serialize the model (represented by reverse multimap) to a json file.
@@ -39,4 +374,16 @@ void train(size_t iterationCount,
 void serializeResult(const string &resultFile,
                      const multimap<rl::FLOAT, rl::StateAction<STATE, ACTION>> &rewardMultimap);
 
+/**
+ * Serialize each pattern's reward, as leading to the goal pattern, to a json file.
+ * @param resultFile The file to which te result will be dumped.
+ * @param patterns The scored patterns.
+ * @param rewards Reward of each pattern.
+ * @param goalState The goal pattern.
+ */
+void serializeResult(const string &resultFile,
+                     const vector<rl::spState<STATE>> &patterns,
+                     const vector<rl::FLOAT> &rewards,
+                     const rl::spState<STATE> &goalState);
+
 }  // namespace APP
\ No newline at end of file
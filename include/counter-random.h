@@ -0,0 +1,62 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstdint>
+
+/*! \class CounterRandom
+ *  \brief Counter based random number generator.
+ *
+ *  The n-th number is a pure function of (seed, n), computed with the
+ *  splitmix64 mixing function, instead of the next state of a sequential
+ *  generator. Numbers can then be drawn in any order, by any thread or process,
+ *  and always come out the same.
+ */
+class CounterRandom {
+ public:
+  /**
+   * @param seed Selects the sequence of numbers.
+   */
+  explicit CounterRandom(uint64_t seed) : _seed(seed) {}
+
+  uint64_t getSeed() const {
+    return this->_seed;
+  }
+
+  /**
+   * @param counter Position in the sequence.
+   * @return The counter-th number of the sequence, uniform over 64 bits.
+   */
+  uint64_t get(uint64_t counter) const {
+    return CounterRandom::mix(CounterRandom::mix(this->_seed) + GOLDEN_GAMMA * (counter + 1));
+  }
+
+  /**
+   * @param counter Position in the sequence.
+   * @param min The smallest number returned.
+   * @param max The largest number returned, at least min.
+   * @return The counter-th number of the sequence, uniform over [min, max]. The
+   *         modulo bias, at most (max - min + 1) / 2^64, is negligible.
+   */
+  uint64_t get(uint64_t counter, uint64_t min, uint64_t max) const {
+    uint64_t range = max - min + 1;
+    return range == 0 ? this->get(counter) : min + this->get(counter) % range;
+  }
+
+ protected:
+  // 2^64 / golden ratio, splitmix64's increment.
+  static constexpr uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+  /**
+   * splitmix64's finalizer, a bijection that spreads every input bit over the output.
+   */
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t _seed;
+};
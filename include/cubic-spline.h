@@ -0,0 +1,73 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include "declares.h"
+#include "metric-data.h"
+
+/*! \class CubicSpline
+ *  \brief Natural cubic spline over a range of a metric's datapoints.
+ *
+ *  Same interpolant as tk::spline with its default (zero curvature) boundary
+ *  conditions, f(t) = a*(t-t_i)^3 + b*(t-t_i)^2 + c*(t-t_i) + y_i, linear
+ *  outside of the range. Reads the datapoints straight from MetricData and
+ *  solves the tridiagonal system with the Thomas algorithm, so fitting needs no
+ *  memory beyond the coefficient arrays the caller provides.
+ */
+class CubicSpline {
+ public:
+  /**
+   * Fits the spline through data[begin, end), O(end - begin).
+   * @param data The datapoints, strictly increasing in time.
+   * @param begin Index of the first datapoint.
+   * @param end Index past the last datapoint.
+   * @param a Output, end - begin long.
+   * @param b Output, end - begin long.
+   * @param c Output, end - begin long.
+   */
+  static void fit(const MetricData& data, size_t begin, size_t end, double* a, double* b, double* c);
+
+  /**
+   * Evaluates a fitted spline at count evenly spaced, increasing times. Each
+   * time's segment is located by galloping forward from the previous one's.
+   * @param data The datapoints the spline was fitted through.
+   * @param begin Index of the first datapoint.
+   * @param end Index past the last datapoint.
+   * @param a Coefficients from fit.
+   * @param b Coefficients from fit.
+   * @param c Coefficients from fit.
+   * @param timeBegin The first time to evaluate at.
+   * @param increment Time between consecutive evaluations, positive.
+   * @param count Number of evaluations.
+   * @param out Output, count long.
+   */
+  static void evaluate(const MetricData& data,
+                       size_t begin,
+                       size_t end,
+                       const double* a,
+                       const double* b,
+                       const double* c,
+                       double timeBegin,
+                       double increment,
+                       size_t count,
+                       double* out);
+
+  /**
+   * Fits through data[begin, end) and evaluates in one go, with the
+   * coefficients in the calling thread's scratch memory. Allocates only when a
+   * thread sees a range longer than any before.
+   * @see fit
+   * @see evaluate
+   */
+  static void interpolate(const MetricData& data,
+                          size_t begin,
+                          size_t end,
+                          double timeBegin,
+                          double increment,
+                          size_t count,
+                          double* out);
+};
@@ -9,7 +9,8 @@
 namespace app {
 const size_t PATTERN_SIZE = 10;
 using time = size_t;
-using point = std::pair<float, time>;
+using value = double;
+using point = std::pair<value, time>;
 
 // Temporary. This represents the goal action.
 // TODO(jandres): remove for the future when actions are actually metrics.
@@ -0,0 +1,110 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace app {
+
+/**
+ * Software conversion, what toHalf does without the F16C instructions.
+ * @param value A float.
+ * @return The nearest IEEE 754 half precision float (ties to even), as its bits.
+ *         NaNs keep their sign, not their payload.
+ */
+inline uint16_t toHalfSoftware(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t absolute = bits & 0x7fffffff;
+
+  if (absolute >= 0x7f800000) {  // Infinity or NaN.
+    return sign | 0x7c00 | (absolute > 0x7f800000 ? 0x0200 : 0);
+  }
+  if (absolute >= 0x477ff000) {  // Rounds past the largest half, 65504.
+    return sign | 0x7c00;
+  }
+  if (absolute <= 0x33000000) {  // Rounds to 0, at most half the smallest subnormal.
+    return sign;
+  }
+
+  // Mantissa bits dropped, and the rounding of what is kept.
+  uint32_t shift;
+  uint32_t kept;
+  uint32_t mantissa;
+  if (absolute < 0x38800000) {  // A subnormal half, in units of 2^-24.
+    shift = 126 - (absolute >> 23);
+    mantissa = (absolute & 0x007fffff) | 0x00800000;
+    kept = mantissa >> shift;
+  } else {  // Rebiases the exponent, 127 to 15.
+    shift = 13;
+    mantissa = absolute;
+    kept = (absolute - 0x38000000) >> shift;
+  }
+  uint32_t dropped = mantissa & ((1u << shift) - 1);
+  uint32_t halfway = 1u << (shift - 1);
+  if (dropped > halfway || (dropped == halfway && (kept & 1) != 0)) {
+    kept++;  // Carries into the exponent when the mantissa overflows.
+  }
+  return static_cast<uint16_t>(sign | kept);
+}
+
+/**
+ * Software conversion, what fromHalf does without the F16C instructions.
+ * @param half An IEEE 754 half precision float's bits.
+ * @return Its value, exactly.
+ */
+inline float fromHalfSoftware(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x03ff;
+
+  uint32_t bits;
+  if (exponent == 0) {  // Zero or subnormal, mantissa * 2^-24.
+    float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+  } else if (exponent == 0x1f) {  // Infinity or NaN.
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * @param value A float.
+ * @return The nearest IEEE 754 half precision float (ties to even), as its bits.
+ *         Uses the F16C instructions when compiled for them.
+ */
+inline uint16_t toHalf(float value) {
+#if defined(__F16C__)
+  return static_cast<uint16_t>(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+  return toHalfSoftware(value);
+#endif
+}
+
+/**
+ * @param half An IEEE 754 half precision float's bits.
+ * @return Its value, exactly.
+ */
+inline float fromHalf(uint16_t half) {
+#if defined(__F16C__)
+  return _cvtsh_ss(half);
+#else
+  return fromHalfSoftware(half);
+#endif
+}
+
+}  // namespace app
@@ -0,0 +1,107 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "declares.h"
+
+class Metric;
+
+namespace app {
+
+/**
+ * How Metric::getPattern turns a window's datapoints into a pattern. Selects one
+ * of the interpolation policies below at runtime.
+ */
+enum class Interpolation {
+  LINEAR,        // LinearInterpolation
+  CATMULL_ROM,   // CatmullRomInterpolation
+  SPLINE,        // SplineInterpolation
+  METRIC_SPLINE  // MetricSplineInterpolation
+};
+
+/**
+ * @param name One of "linear", "catmullRom", "spline" or "metricSpline".
+ * @return The interpolation with the given name.
+ * @throw std::domain_error if there is no interpolation with the given name.
+ */
+Interpolation parseInterpolation(const std::string &name);
+
+}  // namespace app
+
+/*
+ * Interpolation policies of Metric::getPattern. Each interpolates the datapoints
+ * [begin, end) of a metric at count evenly spaced, increasing times, extrapolating
+ * linearly outside of the datapoints' range:
+ *
+ *   static void interpolate(const Metric& metric, size_t begin, size_t end,
+ *                           double timeBegin, double increment, size_t count,
+ *                           double* out);
+ *
+ * From cheapest to most faithful to the original (spline) patterns.
+ */
+
+/*! \class LinearInterpolation
+ *  \brief Straight line between the two datapoints around each time. O(count).
+ */
+struct LinearInterpolation {
+  static void interpolate(const Metric& metric,
+                          size_t begin,
+                          size_t end,
+                          double timeBegin,
+                          double increment,
+                          size_t count,
+                          double* out);
+};
+
+/*! \class CatmullRomInterpolation
+ *  \brief Local cubic through the four datapoints around each time. O(count).
+ *
+ *  Cubic Hermite segments with finite difference (Catmull-Rom) tangents, so it
+ *  passes through every datapoint and has a continuous first derivative, like
+ *  the spline, but only looks at neighbouring datapoints.
+ */
+struct CatmullRomInterpolation {
+  static void interpolate(const Metric& metric,
+                          size_t begin,
+                          size_t end,
+                          double timeBegin,
+                          double increment,
+                          size_t count,
+                          double* out);
+};
+
+/*! \class SplineInterpolation
+ *  \brief Natural cubic spline fitted over the window. O(end - begin).
+ *
+ *  The exact, original patterns. @see CubicSpline::interpolate
+ */
+struct SplineInterpolation {
+  static void interpolate(const Metric& metric,
+                          size_t begin,
+                          size_t end,
+                          double timeBegin,
+                          double increment,
+                          size_t count,
+                          double* out);
+};
+
+/*! \class MetricSplineInterpolation
+ *  \brief Natural cubic spline fitted once over the whole metric. O(count).
+ *
+ *  Differs slightly from SplineInterpolation near the window's edges.
+ *  @see Metric::getSpline
+ */
+struct MetricSplineInterpolation {
+  static void interpolate(const Metric& metric,
+                          size_t begin,
+                          size_t end,
+                          double timeBegin,
+                          double increment,
+                          size_t count,
+                          double* out);
+};
@@ -0,0 +1,279 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+#include "declares.h"
+
+using std::vector;
+
+/*! \class MetricData
+ *  \brief Column storage of a metric's datapoints.
+ *
+ *  Timestamps and values are kept in two contiguous columns. The columns are
+ *  either owned by this object or borrowed from a memory mapped MetricStore, in
+ *  which case the owner keeps the mapping alive. Copies share the columns.
+ *
+ *  Series sampled at a constant step are stored as (timeBegin, step, values),
+ *  without a timestamp column, and map times to indices arithmetically.
+ */
+class MetricData {
+ public:
+  MetricData() : _times(nullptr), _values(nullptr), _size(0), _timeBegin(0), _step(0) {}
+
+  /**
+   * Owning constructor. The timestamp column is dropped if the series has a
+   * constant step.
+   * @param times The timestamp column, sorted ascending.
+   * @param values The value column, same length as times.
+   */
+  MetricData(vector<app::time>&& times, vector<app::value>&& values) :
+      _times(nullptr),
+      _values(nullptr),
+      _size(times.size()),
+      _timeBegin(times.empty() ? 0 : times.front()),
+      _step(MetricData::detectStep(times.data(), times.size())) {
+    std::shared_ptr<Columns> columns(new Columns());
+    if (this->_step == 0) {
+      columns->times = std::move(times);
+      columns->times.shrink_to_fit();
+      this->_times = columns->times.data();
+    }
+    columns->values = std::move(values);
+    columns->values.shrink_to_fit();
+    this->_values = columns->values.data();
+    this->_owner = columns;
+  }
+
+  /**
+   * Owning constructor.
+   * @param points (value, time) pairs, sorted by time.
+   */
+  MetricData(const vector<app::point>& points) {
+    vector<app::time> times;
+    vector<app::value> values;
+    times.reserve(points.size());
+    values.reserve(points.size());
+    for (const auto& p : points) {
+      values.push_back(p.first);
+      times.push_back(p.second);
+    }
+    *this = MetricData(std::move(times), std::move(values));
+  }
+
+  /**
+   * Borrowing constructor for irregularly sampled series.
+   * @param times The timestamp column, sorted ascending.
+   * @param values The value column.
+   * @param size Number of datapoints in both columns.
+   * @param owner Keeps the memory both columns point to alive.
+   */
+  MetricData(const app::time* times,
+             const app::value* values,
+             size_t size,
+             std::shared_ptr<const void> owner) :
+      _times(times),
+      _values(values),
+      _size(size),
+      _timeBegin(size == 0 ? 0 : times[0]),
+      _step(0),
+      _owner(owner) {}
+
+  /**
+   * Borrowing constructor for series sampled at a constant step.
+   * @param timeBegin Time of the first datapoint.
+   * @param step Time between consecutive datapoints, non-zero.
+   * @param values The value column.
+   * @param size Number of datapoints.
+   * @param owner Keeps the memory the value column points to alive.
+   */
+  MetricData(app::time timeBegin,
+             app::time step,
+             const app::value* values,
+             size_t size,
+             std::shared_ptr<const void> owner) :
+      _times(nullptr),
+      _values(values),
+      _size(size),
+      _timeBegin(timeBegin),
+      _step(step),
+      _owner(owner) {}
+
+  /**
+   * @return Number of datapoints.
+   */
+  size_t size() const {
+    return this->_size;
+  }
+
+  bool empty() const {
+    return this->_size == 0;
+  }
+
+  /**
+   * @return true if the series has a constant step and no timestamp column.
+   */
+  bool isFixedStep() const {
+    return this->_step != 0;
+  }
+
+  /**
+   * @return Time between consecutive datapoints, 0 if the series is irregular.
+   */
+  app::time getStep() const {
+    return this->_step;
+  }
+
+  /**
+   * @return The timestamp column, nullptr for fixed step series.
+   */
+  const app::time* times() const {
+    return this->_times;
+  }
+
+  /**
+   * @return The value column.
+   */
+  const app::value* values() const {
+    return this->_values;
+  }
+
+  app::time timeAt(size_t index) const {
+    return this->_step != 0 ? this->_timeBegin + index * this->_step : this->_times[index];
+  }
+
+  app::value valueAt(size_t index) const {
+    return this->_values[index];
+  }
+
+  /**
+   * @return (value, time) pair of the datapoint at index.
+   */
+  app::point operator[](size_t index) const {
+    return app::point(this->_values[index], this->timeAt(index));
+  }
+
+  app::point front() const {
+    return (*this)[0];
+  }
+
+  app::point back() const {
+    return (*this)[this->_size - 1];
+  }
+
+  /**
+   * Binary search on the timestamp column, O(1) for fixed step series.
+   * @param time (unixtimestamp).
+   * @return Index of the first datapoint at or after time, size() if there is none.
+   */
+  size_t lowerBound(app::time time) const {
+    if (this->_step != 0) {
+      if (time <= this->_timeBegin) {
+        return 0;
+      }
+      return std::min((time - this->_timeBegin + this->_step - 1) / this->_step, this->_size);
+    }
+    return std::lower_bound(this->_times, this->_times + this->_size, time) - this->_times;
+  }
+
+  /**
+   * Binary search on the timestamp column, O(1) for fixed step series.
+   * @param time (unixtimestamp).
+   * @return Index of the first datapoint after time, size() if there is none.
+   */
+  size_t upperBound(app::time time) const {
+    if (this->_step != 0) {
+      if (time < this->_timeBegin) {
+        return 0;
+      }
+      return std::min((time - this->_timeBegin) / this->_step + 1, this->_size);
+    }
+    return std::upper_bound(this->_times, this->_times + this->_size, time) - this->_times;
+  }
+
+  /**
+   * Same as lowerBound, but gallops forward from an index known to be at or
+   * before the result. O(log(result - from)).
+   * @param time (unixtimestamp).
+   * @param from Index at or before the result.
+   */
+  size_t lowerBoundFrom(app::time time, size_t from) const {
+    if (this->_step != 0) {
+      return this->lowerBound(time);
+    }
+    return this->gallop(from, [time](app::time t) { return t < time; });
+  }
+
+  /**
+   * Same as upperBound, but gallops forward from an index known to be at or
+   * before the result. O(log(result - from)).
+   * @param time (unixtimestamp).
+   * @param from Index at or before the result.
+   */
+  size_t upperBoundFrom(app::time time, size_t from) const {
+    if (this->_step != 0) {
+      return this->upperBound(time);
+    }
+    return this->gallop(from, [time](app::time t) { return t <= time; });
+  }
+
+  /**
+   * @param times Timestamps, sorted ascending.
+   * @param size Number of timestamps.
+   * @return The constant step between the timestamps, 0 if there is none.
+   */
+  static app::time detectStep(const app::time* times, size_t size) {
+    if (size < 2 || times[1] <= times[0]) {
+      return 0;
+    }
+
+    app::time step = times[1] - times[0];
+    for (size_t i = 2; i < size; i++) {
+      if (times[i] - times[i - 1] != step) {
+        return 0;
+      }
+    }
+    return step;
+  }
+
+ protected:
+  /**
+   * Exponential search for the first index where isBefore is false.
+   * @param from Index at or before the result.
+   * @param isBefore Predicate, true for every timestamp before the result.
+   */
+  template <class PREDICATE>
+  size_t gallop(size_t from, PREDICATE isBefore) const {
+    if (from >= this->_size || !isBefore(this->_times[from])) {
+      return from;
+    }
+
+    // Invariant: isBefore(_times[low]).
+    size_t low = from;
+    size_t step = 1;
+    while (low + step < this->_size && isBefore(this->_times[low + step])) {
+      low += step;
+      step <<= 1;
+    }
+    size_t high = std::min(low + step, this->_size);
+    return std::partition_point(this->_times + low + 1, this->_times + high, isBefore) - this->_times;
+  }
+
+  struct Columns {
+    vector<app::time> times;
+    vector<app::value> values;
+  };
+
+  const app::time* _times;
+  const app::value* _values;
+  size_t _size;
+  app::time _timeBegin;
+  app::time _step;
+  std::shared_ptr<const void> _owner;
+};
@@ -0,0 +1,215 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+
+#include "declares.h"
+#include "metric.h"
+#include "plot-pattern.h"
+
+using std::vector;
+
+/*! \class MetricGrid
+ *  \brief Metrics resampled once onto a shared time grid.
+ *
+ *  Row i holds metrics[i] linearly interpolated at timeBegin + step * column,
+ *  clamped to the metric's first/last value outside of its range. Rows are
+ *  contiguous doubles, the precision of the metrics, padded so every row starts
+ *  on a cache line. Extracting a pattern is then a strided read of a row instead
+ *  of a spline fit.
+ */
+class MetricGrid {
+ public:
+  /**
+   * @param metrics The metrics to resample, one row each, in order.
+   * @param timeBegin The first time of the grid (unix time stamp).
+   * @param timeEnd The last time the grid has to cover (unix time stamp).
+   * @param step Time between grid columns, non-zero.
+   * @param maxBytes Largest grid to allocate, see getSizeInBytes.
+   * @throw std::invalid_argument if step is 0 or timeEnd < timeBegin.
+   * @throw std::length_error if the grid would be larger than maxBytes.
+   */
+  MetricGrid(const vector<std::shared_ptr<Metric>>& metrics,
+             app::time timeBegin,
+             app::time timeEnd,
+             app::time step,
+             size_t maxBytes = DEFAULT_MAX_BYTES);
+
+  static const size_t DEFAULT_MAX_BYTES = static_cast<size_t>(1) << 30;
+
+  /**
+   * @param metricCount Number of rows.
+   * @param timeBegin The first time of the grid (unix time stamp).
+   * @param timeEnd The last time the grid has to cover (unix time stamp).
+   * @param step Time between grid columns, non-zero.
+   * @return Bytes a grid of these dimensions allocates, SIZE_MAX if that overflows.
+   */
+  static size_t getSizeInBytes(size_t metricCount, app::time timeBegin, app::time timeEnd, app::time step);
+
+  size_t getRowCount() const {
+    return this->_metrics.size();
+  }
+
+  size_t getColumnCount() const {
+    return this->_columnCount;
+  }
+
+  app::time getTimeBegin() const {
+    return this->_timeBegin;
+  }
+
+  app::time getStep() const {
+    return this->_step;
+  }
+
+  /**
+   * @param row Row index.
+   * @return The resampled values of the row's metric, getColumnCount() long.
+   */
+  const double* getRow(size_t row) const {
+    return this->_values.get() + row * this->_rowStride;
+  }
+
+  /**
+   * @param metric The metric to look for.
+   * @return Row of the metric.
+   * @throw std::invalid_argument if the metric is not in the grid.
+   */
+  size_t findRow(const std::shared_ptr<Metric>& metric) const;
+
+  /**
+   * Same as Metric::getPattern, but samples the resampled row instead of
+   * fitting a spline. The window is accepted or rejected exactly as
+   * Metric::getPattern does.
+   * @tparam RESOLUTION Resolution of pattern to generate.
+   * @param row Row of the metric to extract pattern from.
+   * @param tBegin The beginning time in metric.
+   * @param tEnd The end time in metric.
+   * @return extracted pattern.
+   * @throw const char* Same as Metric::getPattern.
+   */
+  template <size_t RESOLUTION>
+  rl::spState<PlotPattern<RESOLUTION>> getPattern(size_t row, app::time tBegin, app::time tEnd) const {
+    rl::spState<PlotPattern<RESOLUTION>> pattern(new PlotPattern<RESOLUTION>());
+    this->getPattern<RESOLUTION>(row, tBegin, tEnd, *pattern);
+    return pattern;
+  }
+
+  /**
+   * Same as getPattern(row, tBegin, tEnd), but extracts into an existing pattern
+   * instead of allocating one, for loops extracting many patterns.
+   * @param pattern Output, the extracted pattern. Unchanged if extraction throws.
+   * @throw const char* getPatternStatusMessage of the status tryGetPattern returns, if not OK.
+   */
+  template <size_t RESOLUTION>
+  void getPattern(size_t row, app::time tBegin, app::time tEnd, PlotPattern<RESOLUTION>& pattern) const {
+    auto status = this->tryGetPattern<RESOLUTION>(row, tBegin, tEnd, pattern);
+    if (status != app::PatternStatus::OK) {
+      throw app::getPatternStatusMessage(status);
+    }
+  }
+
+  /**
+   * Same as getPattern(row, tBegin, tEnd, pattern), but returns why a window is
+   * rejected instead of throwing. Rejects the same windows as Metric::tryGetPattern.
+   * @param pattern Output, the extracted pattern. Unchanged unless OK is returned.
+   * @return OK, or why no pattern could be extracted.
+   */
+  template <size_t RESOLUTION>
+  app::PatternStatus tryGetPattern(size_t row,
+                                   app::time tBegin,
+                                   app::time tEnd,
+                                   PlotPattern<RESOLUTION>& pattern) const {
+    double y[RESOLUTION];
+    auto status = this->tryInterpolate<RESOLUTION>(row, tBegin, tEnd, y);
+    if (status != app::PatternStatus::OK) {
+      return status;
+    }
+
+    typename PlotPattern<RESOLUTION>::DATA data;
+    double durationIncrement = static_cast<double>(tEnd - tBegin)/RESOLUTION;
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      data[i] = std::pair<double, double>({y[i], static_cast<double>(tBegin) + durationIncrement*i});
+    }
+    pattern = PlotPattern<RESOLUTION>(this->_metrics[row], data);
+    return app::PatternStatus::OK;
+  }
+
+  /**
+   * Same as tryGetPattern, but only extracts the pattern's normalized y values,
+   * see Metric::tryGetFeatures.
+   * @param features Output, the pattern's features. Unchanged unless OK is returned.
+   * @return OK, or why no pattern could be extracted.
+   */
+  template <size_t RESOLUTION>
+  app::PatternStatus tryGetFeatures(size_t row,
+                                    app::time tBegin,
+                                    app::time tEnd,
+                                    PatternFeatures<RESOLUTION>& features) const {
+    double y[RESOLUTION];
+    auto status = this->tryInterpolate<RESOLUTION>(row, tBegin, tEnd, y);
+    if (status == app::PatternStatus::OK) {
+      features.normalize(y);
+    }
+    return status;
+  }
+
+ protected:
+  /**
+   * Checks the window as Metric::tryGetPattern does, then samples the row at
+   * RESOLUTION evenly spaced times in [tBegin, tEnd), into y.
+   */
+  template <size_t RESOLUTION>
+  app::PatternStatus tryInterpolate(size_t row, app::time tBegin, app::time tEnd, double* y) const {
+    const auto& metric = this->_metrics[row];
+    if (tBegin > metric->getTimeEnd()) {
+      return app::PatternStatus::AFTER_METRIC_END;
+    }
+    if (tEnd < metric->getTimeBegin()) {
+      return app::PatternStatus::BEFORE_METRIC_BEGIN;
+    }
+    size_t beginI = metric->getIndexAfter(tBegin);
+    size_t endI = metric->getIndexBefore(tEnd);
+    if (endI <= beginI + 2) {
+      return app::PatternStatus::NOT_ENOUGH_RESOLUTION;
+    }
+
+    const double* values = this->getRow(row);
+    double lastColumn = static_cast<double>(this->_columnCount - 1);
+    double durationIncrement = static_cast<double>(tEnd - tBegin)/RESOLUTION;
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      double time = static_cast<double>(tBegin) + durationIncrement*i;
+      double position = (time - static_cast<double>(this->_timeBegin)) / this->_step;
+      position = std::min(std::max(position, 0.0), lastColumn);
+
+      size_t column = static_cast<size_t>(position);
+      y[i] = values[column];
+      if (column + 1 < this->_columnCount) {
+        y[i] += (values[column + 1] - values[column]) * (position - column);
+      }
+    }
+    return app::PatternStatus::OK;
+  }
+
+  struct FreeDeleter {
+    void operator()(double* p) const { std::free(p); }
+  };
+
+  /**
+   * Resamples metric into row.
+   */
+  void resample(const Metric& metric, double* row) const;
+
+  vector<std::shared_ptr<Metric>> _metrics;
+  app::time _timeBegin;
+  app::time _step;
+  size_t _columnCount;
+  size_t _rowStride;  // Values between the start of consecutive rows.
+  std::unique_ptr<double[], FreeDeleter> _values;
+};
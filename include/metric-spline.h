@@ -0,0 +1,41 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "declares.h"
+#include "metric-data.h"
+
+using std::vector;
+
+/*! \class MetricSpline
+ *  \brief Natural cubic spline through every datapoint of a metric.
+ *
+ *  A CubicSpline fitted once over the whole series, with its coefficients
+ *  kept, so a window is extracted by evaluation alone.
+ */
+class MetricSpline {
+ public:
+  /**
+   * Fits the spline, O(n).
+   * @param data The datapoints to interpolate, strictly increasing in time.
+   */
+  explicit MetricSpline(const MetricData& data);
+
+  /**
+   * Evaluates the spline at count evenly spaced, increasing times.
+   * @see CubicSpline::evaluate
+   * @param timeBegin The first time to evaluate at.
+   * @param increment Time between consecutive evaluations, positive.
+   * @param count Number of evaluations.
+   * @param out Output, count long.
+   */
+  void evaluate(double timeBegin, double increment, size_t count, double* out) const;
+
+ protected:
+  MetricData _data;
+  vector<double> _a, _b, _c;
+};
@@ -0,0 +1,101 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "declares.h"
+#include "metric.h"
+
+using std::vector;
+using std::string;
+
+/*! \class MetricStore
+ *  \brief Binary, columnar, memory mapped storage of metrics.
+ *
+ *  Layout (native endianness, all offsets in bytes from the beginning of file):
+ *  - Header.
+ *  - IndexEntry per metric, in metric index order.
+ *  - Name table, the concatenated metric names.
+ *  - Timestamp column, every irregular metric's timestamps back to back (64 byte
+ *    aligned). Fixed step metrics only store their first time and step.
+ *  - Value column, every metric's values back to back (64 byte aligned).
+ *
+ *  Metrics returned by a store borrow their columns from the mapping, so
+ *  opening a store costs the index and name table only, and the page cache
+ *  is shared between runs.
+ */
+class MetricStore : public std::enable_shared_from_this<MetricStore> {
+ public:
+  static const uint32_t VERSION = 2;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t valueSize;  // sizeof(app::value) of the writer.
+    uint64_t metricCount;
+    uint64_t pointCount;
+    uint64_t timeCount;  // Length of the timestamp column.
+    uint64_t indexOffset;
+    uint64_t nameTableOffset;
+    uint64_t timeColumnOffset;
+    uint64_t valueColumnOffset;
+  };
+
+  struct IndexEntry {
+    uint64_t nameOffset;  // Relative to the name table.
+    uint64_t nameLength;
+    uint64_t pointCount;
+    uint64_t firstValue;  // Index of the metric's first value in the value column.
+    uint64_t firstTime;  // Index of the metric's first timestamp, if step is 0.
+    uint64_t timeBegin;
+    uint64_t step;  // 0 for irregular metrics.
+  };
+
+  ~MetricStore();
+
+  /**
+   * Writes metrics into a binary store.
+   * @param fileName The file to write to.
+   * @param metrics The metrics to write, stored in their metric index order.
+   * @throw std::runtime_error if the file can't be written.
+   */
+  static void write(const string& fileName, const vector<std::shared_ptr<Metric>>& metrics);
+
+  /**
+   * Memory maps a binary store.
+   * @param fileName The file written by MetricStore::write.
+   * @return The mapped store.
+   * @throw std::runtime_error if the file can't be mapped or is not a valid store.
+   */
+  static std::shared_ptr<MetricStore> open(const string& fileName);
+
+  /**
+   * @param fileName The file to check.
+   * @return true if the file starts with a MetricStore header.
+   */
+  static bool isMetricStore(const string& fileName);
+
+  /**
+   * @return Number of metrics in the store.
+   */
+  size_t size() const;
+
+  /**
+   * @return Metrics backed by the mapped columns. They keep the store alive.
+   */
+  vector<std::shared_ptr<Metric>> getMetrics();
+
+ protected:
+  MetricStore();
+
+  const char* _mapping;
+  size_t _mappingSize;
+  const Header* _header;
+  const IndexEntry* _index;
+};
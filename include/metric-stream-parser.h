@@ -0,0 +1,64 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "declares.h"
+
+using std::vector;
+using std::string;
+
+/*! \class MetricStreamParser
+ *  \brief Pull parser for graphite's metric export.
+ *
+ *  Walks `[{"target": ..., "datapoints": [[y, x], ...]}, ...]` one metric at a
+ *  time straight from a stream, so the raw file and a json DOM of it are never
+ *  held in memory. Unknown keys in a metric object are skipped.
+ */
+class MetricStreamParser {
+ public:
+  /**
+   * @param stream The stream to read the metric array from.
+   * @param bufferSize Size of the read buffer in bytes.
+   */
+  explicit MetricStreamParser(std::istream& stream, size_t bufferSize = 1 << 16);
+
+  /**
+   * Parses the next metric in the array.
+   * @param target Output. Name of the metric, empty if target is null.
+   * @param hasTarget Output. False if the metric's target is null or missing.
+   * @param times Output. Timestamp column of the metric (cleared first).
+   * @param values Output. Value column of the metric (cleared first).
+   * @return false if there are no more metrics in the array.
+   * @throw std::domain_error if the stream is not a valid metric array.
+   */
+  bool next(string& target, bool& hasTarget, vector<app::time>& times, vector<app::value>& values);
+
+ protected:
+  bool fill();
+  void expectEnd();
+  int peek();
+  int get();
+  void skipWhitespace();
+  void expect(char c);
+  void expectLiteral(const char* literal);
+  void parseString(string& out);
+  unsigned long parseHex4();
+  double parseNumber();
+  void parseDatapoints(vector<app::time>& times, vector<app::value>& values);
+  void skipValue();
+  void fail(const string& reason) const;
+
+  std::istream& _stream;
+  vector<char> _buffer;
+  size_t _position;
+  size_t _size;
+  size_t _offset;  // Bytes consumed before the current buffer, for error messages.
+  bool _begun;
+  bool _ended;
+};
@@ -10,24 +10,36 @@
 #include <cmath>
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include "../lib/json.hpp"
 
 #include "declares.h"
-#include "../lib/spline.h"
+#include "interpolation.h"
+#include "metric-data.h"
+#include "metric-spline.h"
+#include "metric-stream-parser.h"
+#include "pattern-status.h"
+#include "task-scheduler.h"
 
 using std::vector;
 using std::array;
 using std::string;
 using json = nlohmann::json;
 
+template <size_t RESOLUTION>
+struct PatternFeatures;
+
+template <size_t RESOLUTION>
+class PlotPattern;
+
 /*! \class Metric
  *  \brief Represents graphite metric.
  */
 class Metric {
  public:
   // The data type of how the metric is stored.
-  using DATA = vector<app::point>;
+  using DATA = MetricData;
 
   /**
    * JSON constructor.
@@ -40,10 +52,13 @@ class Metric {
     }
 
     this->_metricName = j["target"];
-    for (auto d : j["datapoints"]) {
-      d[0] = d[0].is_null() ? 0 : (int)d[0];
-      this->_data.push_back(app::point({d[0], d[1]}));
+    vector<app::time> times;
+    vector<app::value> values;
+    for (auto& d : j["datapoints"]) {
+      values.push_back(d[0].is_null() ? 0.0 : d[0].get<app::value>());
+      times.push_back(d[1]);
     }
+    this->_data = DATA(std::move(times), std::move(values));
   }
 
   /**
@@ -56,6 +71,16 @@ class Metric {
       _data(data),
       _metricIndex(metricIndex) {}
 
+  /**
+   * Move constructor, takes ownership of the data without copying it.
+   * @param metricName Name of the metric.
+   * @param data The data in the metric.
+   */
+  Metric(string metricName, DATA&& data, size_t metricIndex) :
+      _data(std::move(data)),
+      _metricName(std::move(metricName)),
+      _metricIndex(metricIndex) {}
+
   bool operator>(const Metric& rhs) const {
     return this->getMetricName() > rhs.getMetricName();
   }
@@ -89,7 +114,7 @@ class Metric {
    * @return The earliest time in metric (unixtimestamp). 
    */
   app::time getTimeBegin() const {
-    return std::get<1>(this->_data.front());
+    return this->_data.timeAt(0);
   }
 
   /**
@@ -97,7 +122,7 @@ class Metric {
    * @return The end time in metric (unixtimestamp). 
    */
   app::time getTimeEnd() const {
-    return std::get<1>(this->_data.back());
+    return this->_data.timeAt(this->_data.size() - 1);
   }
 
   /**
@@ -106,13 +131,9 @@ class Metric {
    * @return the nearest "greater time" located in the metric.
    */
   app::time getTimeAfter(app::time time) const {
-    for (auto d : this->_data) {
-      if (std::get<1>(d) >= time) {
-        return std::get<1>(d);
-      }
-    }
-
-    assert(false /* Given time exceeded range. */);
+    size_t index = this->_data.lowerBound(time);
+    assert(index < this->_data.size() /* Given time exceeded range. */);
+    return this->_data.timeAt(index);
   }
 
   /***
@@ -121,14 +142,9 @@ class Metric {
    * @return the nearest "time less-than" located in the metric.
    */
   app::time getTimeBefore(app::time time) const {
-    for (auto iter = this->_data.rbegin(); iter != this->_data.rend(); iter++) {
-      auto d = *iter;
-      if (std::get<1>(d) <= time) {
-        return std::get<1>(d);
-      }
-    }
-
-    assert(false /* Given time is less than range. */);
+    size_t index = this->_data.upperBound(time);
+    assert(index > 0 /* Given time is less than range. */);
+    return this->_data.timeAt(index - 1);
   }
 
  /**
@@ -141,15 +157,7 @@ class Metric {
       throw "time exceeded Metric::getTimeEnd()";
     }
 
-    size_t index = 0;
-    for (auto d : this->_data) {
-      if (std::get<1>(d) >= time) {
-        return index;
-      }
-      index++;
-    }
-
-    assert(false /* Given time exceeded range. */);
+    return this->_data.lowerBound(time);
   }
 
   /**
@@ -162,16 +170,7 @@ class Metric {
       throw "time is less than Metric::getTimeBegin()";
     }
 
-    size_t index = this->_data.size() - 1;
-    for (auto iter = this->_data.rbegin(); iter != this->_data.rend(); iter++) {
-      auto d = *iter;
-      if (std::get<1>(d) <= time) {
-        return index;
-      }
-      index--;
-    }
-
-    assert(false /* Given time is less than range. */);
+    return this->_data.upperBound(time) - 1;
   }
 
   /**
@@ -209,47 +208,198 @@ class Metric {
    * Acquires a pattern from a given matrix, given a tBegin, and tEnd.
    * @static
    * @tparam RESOLUTION Resolution of pattern to generate.
+   * @tparam INTERPOLATION Interpolation policy (see interpolation.h). Whatever
+   *                       the policy, the same windows are rejected.
    *
    * @param metric Metric to extract pattern from.
    * @param tBegin The beginning time in metric.
    * @param tEnd The end time in metric.
    * @return extracted pattern.
+   * @throw const char* getPatternStatusMessage of the status tryGetPattern returns, if not OK.
    */
-  template <size_t RESOLUTION>
+  template <size_t RESOLUTION, class INTERPOLATION = SplineInterpolation>
   static rl::spState<PlotPattern<RESOLUTION>> getPattern(const std::shared_ptr<Metric>& metric,
                                                        app::time tBegin,
                                                        app::time tEnd) {
-    assert(tEnd > tBegin);
+    rl::spState<PlotPattern<RESOLUTION>> pattern(new PlotPattern<RESOLUTION>());
+    Metric::getPattern<RESOLUTION, INTERPOLATION>(metric, tBegin, tEnd, *pattern);
+    return pattern;
+  }
 
-    app::time beginI = metric->getIndexAfter(tBegin);
-    app::time endI = metric->getIndexBefore(tEnd);
+  /**
+   * Same as getPattern(metric, tBegin, tEnd), but extracts into an existing
+   * pattern instead of allocating one, for loops extracting many patterns.
+   * @param pattern Output, the extracted pattern. Unchanged if extraction throws.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION = SplineInterpolation>
+  static void getPattern(const std::shared_ptr<Metric>& metric,
+                         app::time tBegin,
+                         app::time tEnd,
+                         PlotPattern<RESOLUTION>& pattern) {
+    auto status = Metric::tryGetPattern<RESOLUTION, INTERPOLATION>(metric, tBegin, tEnd, pattern);
+    if (status != app::PatternStatus::OK) {
+      throw app::getPatternStatusMessage(status);
+    }
+  }
 
-    if (endI - beginI <= 2) {
-      throw "Not enough resolution";
+  /**
+   * Same as getPattern(metric, tBegin, tEnd, pattern), but returns why a window
+   * is rejected instead of throwing, for loops where many windows are.
+   * @param pattern Output, the extracted pattern. Unchanged unless OK is returned.
+   * @return OK, or why no pattern could be extracted.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION = SplineInterpolation>
+  static app::PatternStatus tryGetPattern(const std::shared_ptr<Metric>& metric,
+                                          app::time tBegin,
+                                          app::time tEnd,
+                                          PlotPattern<RESOLUTION>& pattern) {
+    double y[RESOLUTION];
+    auto status = Metric::tryInterpolate<RESOLUTION, INTERPOLATION>(*metric, tBegin, tEnd, y);
+    if (status == app::PatternStatus::OK) {
+      Metric::setPattern<RESOLUTION>(metric, tBegin, tEnd, y, pattern);
     }
+    return status;
+  }
 
-    std::vector<double> x;
-    std::vector<double> y;
+  /**
+   * Same as tryGetPattern, but only extracts the pattern's normalized y values,
+   * for loops that need neither the pattern's metric nor its times.
+   * @param features Output, the pattern's features. Unchanged unless OK is returned.
+   * @return OK, or why no pattern could be extracted.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION = SplineInterpolation>
+  static app::PatternStatus tryGetFeatures(const Metric& metric,
+                                           app::time tBegin,
+                                           app::time tEnd,
+                                           PatternFeatures<RESOLUTION>& features) {
+    double y[RESOLUTION];
+    auto status = Metric::tryInterpolate<RESOLUTION, INTERPOLATION>(metric, tBegin, tEnd, y);
+    if (status == app::PatternStatus::OK) {
+      features.normalize(y);
+    }
+    return status;
+  }
 
-    for (size_t i = beginI, j = 0; i < endI; i++, j++) {
-      x.push_back(metric->_data[i].second);
+  /*! \class WindowCursor
+   *  \brief Index range of a window that moves through a metric.
+   *
+   *  Windows that move forward in time are located by galloping from the
+   *  previous window's indices, amortized O(1) for callers iterating windows in
+   *  time order. Moving backward falls back to binary search.
+   */
+  class WindowCursor {
+   public:
+    /**
+     * @param metric The metric the windows are located in.
+     */
+    explicit WindowCursor(const std::shared_ptr<Metric>& metric) :
+        _metric(metric),
+        _lowerBound(0),
+        _upperBound(0),
+        _tBegin(0),
+        _tEnd(0) {}
+
+    /**
+     * Moves the cursor to [tBegin, tEnd].
+     * @param tBegin The beginning time in metric.
+     * @param tEnd The end time in metric.
+     * @throw const char* Same as Metric::getIndexAfter and Metric::getIndexBefore.
+     */
+    void seek(app::time tBegin, app::time tEnd) {
+      auto status = this->trySeek(tBegin, tEnd);
+      if (status != app::PatternStatus::OK) {
+        throw app::getPatternStatusMessage(status);
+      }
     }
-    for (size_t i = beginI, j = 0; i < endI; i++, j++) {
-      y.push_back(metric->_data[i].first);
+
+    /**
+     * Same as seek, but returns why the window is out of the metric's range instead of throwing.
+     * @return OK, AFTER_METRIC_END or BEFORE_METRIC_BEGIN. The cursor only moves if OK.
+     */
+    app::PatternStatus trySeek(app::time tBegin, app::time tEnd) {
+      const DATA& data = this->_metric->getData();
+      if (tBegin > this->_metric->getTimeEnd()) {
+        return app::PatternStatus::AFTER_METRIC_END;
+      }
+      if (tEnd < this->_metric->getTimeBegin()) {
+        return app::PatternStatus::BEFORE_METRIC_BEGIN;
+      }
+
+      this->_lowerBound = tBegin >= this->_tBegin ?
+          data.lowerBoundFrom(tBegin, this->_lowerBound) : data.lowerBound(tBegin);
+      this->_upperBound = tEnd >= this->_tEnd ?
+          data.upperBoundFrom(tEnd, this->_upperBound) : data.upperBound(tEnd);
+      this->_tBegin = tBegin;
+      this->_tEnd = tEnd;
+      return app::PatternStatus::OK;
     }
 
-    tk::spline interpolatedPattern;
-    interpolatedPattern.set_points(x, y);
+    /**
+     * @return Same as Metric::getIndexAfter(tBegin) of the last seek.
+     */
+    size_t getIndexAfter() const {
+      return this->_lowerBound;
+    }
 
-    typename PlotPattern<RESOLUTION>::DATA data;
-    double durationIncrement = static_cast<double>(tEnd - tBegin)/RESOLUTION;
-    for (size_t i = 0; i < RESOLUTION; i++) {
-      double time = static_cast<double>(tBegin) + durationIncrement*i;
-      float y = interpolatedPattern(time);
-      data[i] = std::pair<double, double>({y, time});
+    /**
+     * @return Same as Metric::getIndexBefore(tEnd) of the last seek.
+     */
+    size_t getIndexBefore() const {
+      return this->_upperBound - 1;
+    }
+
+    const std::shared_ptr<Metric>& getMetric() const {
+      return this->_metric;
     }
 
-    return rl::spState<PlotPattern<RESOLUTION>>(new PlotPattern<RESOLUTION>(metric, data));
+   protected:
+    std::shared_ptr<Metric> _metric;
+    size_t _lowerBound;
+    size_t _upperBound;
+    app::time _tBegin;
+    app::time _tEnd;
+  };
+
+  /**
+   * Same as getPattern(metric, tBegin, tEnd), but locates the window with a
+   * cursor. Use when extracting windows in time order.
+   * @param cursor Cursor over the metric to extract pattern from.
+   * @param tBegin The beginning time in metric.
+   * @param tEnd The end time in metric.
+   * @return extracted pattern.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION = SplineInterpolation>
+  static rl::spState<PlotPattern<RESOLUTION>> getPattern(WindowCursor& cursor,
+                                                       app::time tBegin,
+                                                       app::time tEnd) {
+    assert(tEnd > tBegin);
+
+    cursor.seek(tBegin, tEnd);
+    rl::spState<PlotPattern<RESOLUTION>> pattern(new PlotPattern<RESOLUTION>());
+    auto status = Metric::interpolatePattern<RESOLUTION, INTERPOLATION>(
+        cursor.getMetric(),
+        cursor.getIndexAfter(),
+        cursor.getIndexBefore(),
+        tBegin,
+        tEnd,
+        *pattern);
+    if (status != app::PatternStatus::OK) {
+      throw app::getPatternStatusMessage(status);
+    }
+    return pattern;
+  }
+
+  /**
+   * Cubic spline through every datapoint of the metric. Fitted on first use
+   * and kept, thread safe. Patterns are extracted from it with
+   * getPattern<RESOLUTION, MetricSplineInterpolation>.
+   * @return The metric's spline.
+   */
+  const MetricSpline& getSpline() const {
+    std::call_once(this->_splineFitted, [this]() {
+      this->_spline.reset(new MetricSpline(this->_data));
+    });
+    return *this->_spline;
   }
 
   /**
@@ -274,6 +424,33 @@ class Metric {
     return metrics;
   }
 
+  /**
+   * Streams an array of metrics, without building a json DOM of it. Datapoints
+   * are parsed directly into each Metric's storage.
+   * @param metricsStream The stream containing the json array of metrics.
+   * @return an array of shared_ptr<Metric>.
+   * @throw std::domain_error if the stream is not a valid metric array.
+   */
+  static std::vector<std::shared_ptr<Metric>> parseMetrics(std::istream& metricsStream) {
+    std::vector<std::shared_ptr<Metric>> metrics;
+    MetricStreamParser parser(metricsStream);
+
+    string target;
+    bool hasTarget;
+    vector<app::time> times;
+    vector<app::value> values;
+    while (parser.next(target, hasTarget, times, values)) {
+      if (!hasTarget) {
+        continue;
+      }
+
+      metrics.push_back(std::shared_ptr<Metric>(
+          new Metric(target, DATA(std::move(times), std::move(values)), metrics.size())));
+    }
+
+    return metrics;
+  }
+
   /**
    * Given a vector of metrics, acquires the min/max time.
    * @param metrics Array of metrics to acquire the min/max time.
@@ -310,40 +487,178 @@ class Metric {
    * @param metrics An array of metric to extract a pattern from.
    * @param patternTimeBegin The begin time of the pattern to extract wihtin the metric.
    * @param patternTimeEnd The end time of the pattern to extract within the metric.
-   * @return array of extracted pattern.
+   * @param scheduler If given, patterns are extracted on its workers.
+   * @param statusCounts If given, the status of every metric's extraction is added to it.
+   * @return array of extracted pattern, in the order of their metrics.
+   * @throw Whatever an extraction throws, such as std::bad_alloc, rethrown on the
+   *        calling thread (see TaskScheduler::parallelFor).
    */
-  template<size_t PATTERN_SIZE>
+  template<size_t PATTERN_SIZE, class INTERPOLATION = SplineInterpolation>
   static vector<rl::spState<PlotPattern<PATTERN_SIZE>>> getPatternsFromMetrics(
-      const vector<shared_ptr<Metric>> metrics,
+      const vector<shared_ptr<Metric>>& metrics,
       app::time patternTimeBegin,
-      app::time patternTimeEnd) {
-    vector<rl::spState<PlotPattern<PATTERN_SIZE>>> patterns;
-    for (auto metric : metrics) {
-      try {
-        patterns.push_back(Metric::getPattern<PATTERN_SIZE>(
-            metric,
+      app::time patternTimeEnd,
+      TaskScheduler* scheduler = nullptr,
+      app::PatternStatusCounts* statusCounts = nullptr) {
+    // One slot per metric, left empty for the metrics a pattern can't be extracted from.
+    vector<rl::spState<PlotPattern<PATTERN_SIZE>>> slots(metrics.size());
+    vector<app::PatternStatus> statuses(metrics.size(), app::PatternStatus::OK);
+    auto extract = [&](size_t begin, size_t end) {
+      PlotPattern<PATTERN_SIZE> pattern;
+      for (size_t i = begin; i < end; i++) {
+        statuses[i] = Metric::tryGetPattern<PATTERN_SIZE, INTERPOLATION>(
+            metrics[i],
             patternTimeBegin,
-            patternTimeEnd));
-      }catch(exception& e) {
-        std::cerr << e.what() << std::endl;
-      }catch(...) {
-        // Invalid resolution of metric.
+            patternTimeEnd,
+            pattern);
+        if (statuses[i] == app::PatternStatus::OK) {
+          slots[i].reset(new PlotPattern<PATTERN_SIZE>(pattern));
+        }
+      }
+    };
+
+    if (scheduler != nullptr) {
+      scheduler->parallelFor(metrics.size(), scheduler->getGrainSize(metrics.size()), extract);
+    } else {
+      extract(0, metrics.size());
+    }
+
+    if (statusCounts != nullptr) {
+      for (auto status : statuses) {
+        statusCounts->add(status);
+      }
+    }
+
+    vector<rl::spState<PlotPattern<PATTERN_SIZE>>> patterns;
+    for (auto& pattern : slots) {
+      if (pattern) {
+        patterns.push_back(std::move(pattern));
       }
     }
 
     return patterns;
   }
 
+  /**
+   * Same as getPatternsFromMetrics<PATTERN_SIZE, INTERPOLATION>, with the
+   * interpolation policy selected at runtime.
+   * @param interpolation The interpolation policy.
+   */
+  template<size_t PATTERN_SIZE>
+  static vector<rl::spState<PlotPattern<PATTERN_SIZE>>> getPatternsFromMetrics(
+      const vector<shared_ptr<Metric>>& metrics,
+      app::time patternTimeBegin,
+      app::time patternTimeEnd,
+      app::Interpolation interpolation,
+      TaskScheduler* scheduler = nullptr,
+      app::PatternStatusCounts* statusCounts = nullptr) {
+    switch (interpolation) {
+      case app::Interpolation::LINEAR:
+        return Metric::getPatternsFromMetrics<PATTERN_SIZE, LinearInterpolation>(
+            metrics, patternTimeBegin, patternTimeEnd, scheduler, statusCounts);
+      case app::Interpolation::CATMULL_ROM:
+        return Metric::getPatternsFromMetrics<PATTERN_SIZE, CatmullRomInterpolation>(
+            metrics, patternTimeBegin, patternTimeEnd, scheduler, statusCounts);
+      case app::Interpolation::METRIC_SPLINE:
+        return Metric::getPatternsFromMetrics<PATTERN_SIZE, MetricSplineInterpolation>(
+            metrics, patternTimeBegin, patternTimeEnd, scheduler, statusCounts);
+      case app::Interpolation::SPLINE:
+      default:
+        return Metric::getPatternsFromMetrics<PATTERN_SIZE, SplineInterpolation>(
+            metrics, patternTimeBegin, patternTimeEnd, scheduler, statusCounts);
+    }
+  }
+
  protected:
+  /**
+   * Locates the window [tBegin, tEnd] in metric, then interpolates it into y,
+   * see interpolateValues.
+   * @return OK, or why no pattern could be extracted.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION>
+  static app::PatternStatus tryInterpolate(const Metric& metric, app::time tBegin, app::time tEnd, double* y) {
+    assert(tEnd > tBegin);
+
+    // Same checks as getIndexAfter(tBegin), then getIndexBefore(tEnd).
+    if (tBegin > metric.getTimeEnd()) {
+      return app::PatternStatus::AFTER_METRIC_END;
+    }
+    if (tEnd < metric.getTimeBegin()) {
+      return app::PatternStatus::BEFORE_METRIC_BEGIN;
+    }
+
+    return Metric::interpolateValues<RESOLUTION, INTERPOLATION>(
+        metric, metric._data.lowerBound(tBegin), metric._data.upperBound(tEnd) - 1, tBegin, tEnd, y);
+  }
+
+  /**
+   * Interpolates the datapoints [beginI, endI) with INTERPOLATION and samples
+   * them at RESOLUTION evenly spaced times in [tBegin, tEnd), into y.
+   * @return NOT_ENOUGH_RESOLUTION if there are not enough datapoints in the window, OK otherwise.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION>
+  static app::PatternStatus interpolateValues(const Metric& metric,
+                                              size_t beginI,
+                                              size_t endI,
+                                              app::time tBegin,
+                                              app::time tEnd,
+                                              double* y) {
+    if (endI <= beginI + 2) {
+      return app::PatternStatus::NOT_ENOUGH_RESOLUTION;
+    }
+
+    double durationIncrement = static_cast<double>(tEnd - tBegin)/RESOLUTION;
+    INTERPOLATION::interpolate(metric, beginI, endI, static_cast<double>(tBegin), durationIncrement, RESOLUTION, y);
+    return app::PatternStatus::OK;
+  }
+
+  /**
+   * Sets pattern to metric's RESOLUTION values y, sampled evenly in [tBegin, tEnd).
+   */
+  template <size_t RESOLUTION>
+  static void setPattern(const std::shared_ptr<Metric>& metric,
+                         app::time tBegin,
+                         app::time tEnd,
+                         const double* y,
+                         PlotPattern<RESOLUTION>& pattern) {
+    double durationIncrement = static_cast<double>(tEnd - tBegin)/RESOLUTION;
+    typename PlotPattern<RESOLUTION>::DATA data;
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      data[i] = std::pair<double, double>({y[i], static_cast<double>(tBegin) + durationIncrement*i});
+    }
+
+    pattern = PlotPattern<RESOLUTION>(metric, data);
+  }
+
+  /**
+   * Same as interpolateValues, into pattern.
+   */
+  template <size_t RESOLUTION, class INTERPOLATION>
+  static app::PatternStatus interpolatePattern(const std::shared_ptr<Metric>& metric,
+                                               size_t beginI,
+                                               size_t endI,
+                                               app::time tBegin,
+                                               app::time tEnd,
+                                               PlotPattern<RESOLUTION>& pattern) {
+    double y[RESOLUTION];
+    auto status = Metric::interpolateValues<RESOLUTION, INTERPOLATION>(*metric, beginI, endI, tBegin, tEnd, y);
+    if (status == app::PatternStatus::OK) {
+      Metric::setPattern<RESOLUTION>(metric, tBegin, tEnd, y, pattern);
+    }
+    return status;
+  }
+
   DATA _data;
   string _metricName;
   size_t _metricIndex;
+  mutable std::once_flag _splineFitted;
+  mutable std::unique_ptr<MetricSpline> _spline;
 };
 
 inline std::ostream& operator <<(std::ostream& stream, const Metric& pp) {
   stream << "{ name: " << pp.getMetricName() << ", data: { ";
-  for (auto d : pp.getData()) {
-    stream << "(" << std::get<0>(d) << ", " << std::get<1>(d) << "), ";
+  for (size_t i = 0; i < pp.getData().size(); i++) {
+    stream << "(" << pp.getData().valueAt(i) << ", " << pp.getData().timeAt(i) << "), ";
   }
   stream << " } }";
   return stream;
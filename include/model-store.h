@@ -0,0 +1,121 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rl>
+
+#include "declares.h"
+#include "metric.h"
+#include "tile-coding.h"
+
+using std::vector;
+using std::string;
+
+class QModel;
+
+/*! \class ModelStore
+ *  \brief Binary, memory mapped storage of a trained model.
+ *
+ *  Layout (native endianness, all offsets in bytes from the beginning of file):
+ *  - Header.
+ *  - IndexEntry per trained metric, in metric index order.
+ *  - Name table, the concatenated metric names.
+ *  - Dense models: weight column, every weight of the table (64 byte aligned).
+ *  - Sparse models (see QModel::Storage): key column, the increasing indices of
+ *    the weights training changed (64 byte aligned), then weight column, their
+ *    weights. Other weights are initialWeight.
+ *
+ *  A state-action's value only reads its tiles' weights, so scoring a window
+ *  only pages in a few pages per metric of the mapped table.
+ */
+class ModelStore {
+ public:
+  static const uint32_t VERSION = 4;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t weightSize;  // sizeof(rl::FLOAT) of the writer.
+    uint64_t modelSize;  // Size of the tile coding's table.
+    uint64_t numTilings;
+    uint64_t metricCount;  // The metric dimension, see app::getMetricDimension.
+    uint32_t isSparse;
+    float initialWeight;
+    uint32_t tileCoder;  // app::TileCoder, since version 4.
+    uint32_t reserved;
+    uint64_t weightCount;  // Length of the weight column.
+    uint64_t indexOffset;
+    uint64_t nameTableOffset;
+    uint64_t keyColumnOffset;  // Sparse models only.
+    uint64_t weightColumnOffset;
+  };
+
+  struct IndexEntry {
+    uint64_t nameOffset;  // Relative to the name table.
+    uint64_t nameLength;
+  };
+
+  ~ModelStore();
+
+  /**
+   * Writes a trained model, and the metric index each metric was trained with.
+   * @param fileName The file to write to.
+   * @param model The trained model, tile coded by app::createTileCode.
+   * @param metrics The trained metrics. Metric::getMetricIndex() is the index they
+   *                were trained with.
+   * @throw std::runtime_error if the file can't be written.
+   */
+  static void write(const string &fileName, const QModel &model, const vector<std::shared_ptr<Metric>> &metrics);
+
+  /**
+   * Memory maps a model, and recreates the tile coding it was trained with.
+   * @param fileName The file written by ModelStore::write.
+   * @return The mapped model.
+   * @throw std::runtime_error if the file can't be mapped or is not a valid model.
+   */
+  static std::shared_ptr<ModelStore> open(const string &fileName);
+
+  /**
+   * @param metricName Name of a metric.
+   * @param metricIndex Output, the index the metric was trained with.
+   * @return false if the metric wasn't trained.
+   */
+  bool findMetricIndex(const string &metricName, size_t &metricIndex) const;
+
+  /**
+   * @return Number of trained metrics.
+   */
+  size_t getMetricCount() const;
+
+  /**
+   * @param state State parameters.
+   * @param action Action parameters.
+   * @return The state-action's value, same as QModel::getValue of the written model.
+   */
+  rl::FLOAT getValue(const rl::floatVector &state, const rl::floatVector &action) const;
+
+ protected:
+  ModelStore();
+
+  /**
+   * @param feature Index of the weight.
+   * @return The weight.
+   */
+  rl::FLOAT getWeight(uint64_t feature) const;
+
+  std::unique_ptr<rl::coding::TileCode> _tileCode;
+  const char* _mapping;
+  size_t _mappingSize;
+  const Header* _header;
+  const uint64_t* _keys;  // Sparse models only.
+  const rl::FLOAT* _weights;
+  std::unordered_map<string, size_t> _metricIndices;
+};
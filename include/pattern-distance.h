@@ -0,0 +1,94 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstddef>
+
+/*! \class PatternDistance
+ *  \brief Distances between one goal pattern and a block of candidate patterns.
+ *
+ *  Patterns are given as their normalized y values (see
+ *  PlotPattern::getNormalizeY), zero padded to paddedSize(resolution) floats.
+ *  Candidates are stored back to back, so a whole block is compared in one
+ *  sequential pass. On x86 the AVX, SSE2 and scalar kernels are all compiled,
+ *  the best one the running CPU supports is picked on first use. Other
+ *  architectures use the scalar kernel.
+ */
+class PatternDistance {
+ public:
+  // Floats per vector register, patterns are padded to a multiple of it.
+  static constexpr size_t LANES = 8;
+
+  enum class Kernel {
+    SCALAR,
+    SSE2,
+    AVX
+  };
+
+  /**
+   * @param kernel A kernel.
+   * @return Whether the kernel is compiled in and the running CPU supports it.
+   */
+  static bool isSupported(Kernel kernel);
+
+  /**
+   * @return The fastest supported kernel, the one absoluteArea and area use.
+   */
+  static Kernel getBestKernel();
+
+  /**
+   * @param resolution Number of y values of a pattern.
+   * @return Floats a pattern of the given resolution is padded to.
+   */
+  static constexpr size_t paddedSize(size_t resolution) {
+    return (resolution + LANES - 1) / LANES * LANES;
+  }
+
+  /**
+   * Same as PlotPattern::getAbsoluteArea between the goal and each candidate.
+   * @param goal The goal pattern, paddedSize(resolution) floats.
+   * @param candidates count candidate patterns, paddedSize(resolution) floats each.
+   * @param count Number of candidates.
+   * @param resolution Number of y values of a pattern.
+   * @param out Output, count long.
+   */
+  static void absoluteArea(const float* goal,
+                           const float* candidates,
+                           size_t count,
+                           size_t resolution,
+                           float* out);
+
+  /**
+   * Same as PlotPattern::getArea between the goal and each candidate.
+   * @see absoluteArea
+   */
+  static void area(const float* goal,
+                   const float* candidates,
+                   size_t count,
+                   size_t resolution,
+                   float* out);
+
+  /**
+   * Same as absoluteArea, with the given kernel.
+   * @param kernel A kernel, isSupported(kernel) must be true.
+   */
+  static void absoluteArea(Kernel kernel,
+                           const float* goal,
+                           const float* candidates,
+                           size_t count,
+                           size_t resolution,
+                           float* out);
+
+  /**
+   * Same as area, with the given kernel.
+   * @param kernel A kernel, isSupported(kernel) must be true.
+   */
+  static void area(Kernel kernel,
+                   const float* goal,
+                   const float* candidates,
+                   size_t count,
+                   size_t resolution,
+                   float* out);
+};
@@ -0,0 +1,83 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace app {
+
+/**
+ * Whether a pattern could be extracted from a metric's window, and if not why.
+ * See Metric::tryGetPattern.
+ */
+enum class PatternStatus {
+  OK,
+  AFTER_METRIC_END,       // The window begins after the metric's last datapoint.
+  BEFORE_METRIC_BEGIN,    // The window ends before the metric's first datapoint.
+  NOT_ENOUGH_RESOLUTION,  // Too few datapoints in the window.
+  COUNT                   // Number of statuses, not a status.
+};
+
+/**
+ * @return The message Metric::getPattern throws for the status.
+ */
+const char* getPatternStatusMessage(PatternStatus status);
+
+/**
+ * @return The status' name, for reports.
+ */
+std::string getPatternStatusName(PatternStatus status);
+
+/*! \class PatternStatusCounts
+ *  \brief Number of extractions that ended with each PatternStatus.
+ */
+class PatternStatusCounts {
+ public:
+  PatternStatusCounts() : _counts() {}
+
+  /**
+   * @param status Status of an extraction.
+   * @param count Number of extractions with that status.
+   */
+  void add(PatternStatus status, size_t count = 1) {
+    this->_counts[static_cast<size_t>(status)] += count;
+  }
+
+  /**
+   * @return Number of extractions with the status.
+   */
+  size_t get(PatternStatus status) const {
+    return this->_counts[static_cast<size_t>(status)];
+  }
+
+  /**
+   * @return Number of extractions that didn't give a pattern.
+   */
+  size_t getRejectedCount() const {
+    return this->getTotal() - this->get(PatternStatus::OK);
+  }
+
+  /**
+   * @return Number of extractions.
+   */
+  size_t getTotal() const {
+    size_t total = 0;
+    for (auto count : this->_counts) {
+      total += count;
+    }
+    return total;
+  }
+
+  /**
+   * @return The rejection counts, e.g. "notEnoughResolution 3, afterMetricEnd 1", or "none".
+   */
+  std::string getRejectionSummary() const;
+
+ protected:
+  size_t _counts[static_cast<size_t>(PatternStatus::COUNT)];
+};
+
+}  // namespace app
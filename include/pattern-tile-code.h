@@ -0,0 +1,158 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <rl>
+
+#include "pattern-distance.h"
+
+/*! \class PatternTileCode
+ *  \brief Tile coding of a PlotPattern's state-action, specialized at compile time.
+ *
+ *  The state-action is RESOLUTION normalized y values in [0, 1], BINS tiles each,
+ *  then the metric index, one tile per index, then the action, which has a
+ *  single tile. Tiling t offsets y value i by the fractional part of
+ *  t * (2i + 1) / TILINGS of a tile, so tilings are not all shifted along the
+ *  same diagonal.
+ *
+ *  getFeatures() computes every tiling's features into a caller's array: each
+ *  block of 8 y values becomes 8 one byte tile coordinates, packed in a word
+ *  (with SSE2 when compiled for it), and a tiling's words, metric index and
+ *  tiling are hashed with multiply-xorshift rounds into the table.
+ *  \tparam RESOLUTION The number of y values.
+ *  \tparam TILINGS The number of tilings.
+ */
+template <size_t RESOLUTION, size_t TILINGS>
+class PatternTileCode : public rl::coding::TileCode {
+ public:
+  // Tiles of a y value.
+  static constexpr size_t BINS = 10;
+
+  // y values read by getFeatures(), the padded length of PatternFeatures<RESOLUTION>.
+  static constexpr size_t PADDED_SIZE = PatternDistance::paddedSize(RESOLUTION);
+
+  /**
+   * @param metricDimension Number of metric indices.
+   * @param tableSize Size of the hashed weight table, a power of 2.
+   * @throw std::domain_error if tableSize is not a power of 2.
+   */
+  PatternTileCode(size_t metricDimension, size_t tableSize) :
+      rl::coding::TileCode(getDimensionInfo(metricDimension), TILINGS),
+      _size(tableSize) {
+    if (tableSize == 0 || (tableSize & (tableSize - 1)) != 0) {
+      throw std::domain_error("The tile coding's table size must be a power of 2.");
+    }
+
+    for (size_t t = 0; t < TILINGS; t++) {
+      for (size_t i = 0; i < PADDED_SIZE; i++) {
+        size_t numerator = t * (2 * i + 1) % TILINGS;
+        this->_offsets[t][i] = i < RESOLUTION ? static_cast<float>(numerator) / TILINGS : 0.0f;
+      }
+    }
+  }
+
+  /**
+   * @param y The normalized y values, PADDED_SIZE floats (PatternFeatures<RESOLUTION>::y).
+   * @param metricIndex The pattern's metric index.
+   * @param features Output, TILINGS weight indices, one per tiling.
+   */
+  void getFeatures(const float* y, size_t metricIndex, size_t* features) const {
+    uint64_t mask = this->_size - 1;
+    for (size_t t = 0; t < TILINGS; t++) {
+      uint64_t h = (static_cast<uint64_t>(metricIndex) * TILINGS + t + 1) * 0x9e3779b97f4a7c15ULL;
+      for (size_t i = 0; i < PADDED_SIZE; i += 8) {
+        h ^= getCoordinates(y + i, this->_offsets[t] + i);
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+      }
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      features[t] = static_cast<size_t>(h & mask);
+    }
+  }
+
+  /**
+   * @param parameters The RESOLUTION y values, the metric index, then the action.
+   * @return TILINGS weight indices, same as getFeatures().
+   */
+  rl::FEATURE_VECTOR getFeatureVector(const rl::floatVector &parameters) const override {
+    if (parameters.size() < RESOLUTION + 1) {
+      throw std::domain_error("Not a pattern's state-action.");
+    }
+
+    alignas(16) float y[PADDED_SIZE] = {};
+    std::copy(parameters.begin(), parameters.begin() + RESOLUTION, y);
+    size_t metricIndex = static_cast<size_t>(std::max(0.0f, std::round(parameters[RESOLUTION])));
+
+    rl::FEATURE_VECTOR features(TILINGS);
+    this->getFeatures(y, metricIndex, features.data());
+    return features;
+  }
+
+  size_t getSize() const override {
+    return this->_size;
+  }
+
+ protected:
+  /**
+   * @return The state-action's dimensions, as app::createTileCode describes them to rl.
+   */
+  static std::vector<rl::coding::DimensionInfo<rl::FLOAT>> getDimensionInfo(size_t metricDimension) {
+    std::vector<rl::coding::DimensionInfo<rl::FLOAT>> dimensionInfo;
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, BINS));
+    }
+    auto lastMetricIndex = static_cast<rl::FLOAT>(metricDimension - 1);
+    dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, lastMetricIndex, metricDimension, 0.0F));
+    dimensionInfo.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 0.0F, 1, 0.0F));
+    return dimensionInfo;
+  }
+
+  /**
+   * @param y 8 y values.
+   * @param offsets Their tiling's offsets.
+   * @return The 8 tile coordinates, byte k is y[k]'s, saturated to [0, 255].
+   */
+  static uint64_t getCoordinates(const float* y, const float* offsets) {
+#if defined(__SSE2__)
+    const __m128 bins = _mm_set1_ps(static_cast<float>(BINS));
+    __m128i low = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(y), bins), _mm_loadu_ps(offsets)));
+    __m128i high = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(y + 4), bins), _mm_loadu_ps(offsets + 4)));
+    __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128());
+    uint64_t coordinates;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&coordinates), bytes);
+    return coordinates;
+#else
+    uint64_t coordinates = 0;
+    for (size_t k = 0; k < 8; k++) {
+      float c = y[k] * BINS + offsets[k];
+      // Same saturation as the SSE2 conversions, NaN included.
+      uint64_t coordinate = c >= 1.0f ? (c < 255.0f ? static_cast<uint64_t>(c) : 255) : 0;
+      coordinates |= coordinate << (8 * k);
+    }
+    return coordinates;
+#endif
+  }
+
+  size_t _size;
+  alignas(16) float _offsets[TILINGS][PADDED_SIZE];
+};
+
+template <size_t RESOLUTION, size_t TILINGS>
+constexpr size_t PatternTileCode<RESOLUTION, TILINGS>::BINS;
+
+template <size_t RESOLUTION, size_t TILINGS>
+constexpr size_t PatternTileCode<RESOLUTION, TILINGS>::PADDED_SIZE;
@@ -10,19 +10,71 @@
 #include <cmath>
 #include <string>
 #include <functional>
+#include <algorithm>
 #include <numeric>
 #include <iostream>
 #include <rl>
 #include <memory>
+#include <type_traits>
 
 #include "declares.h"
-#include "../lib/spline.h"
+#include "metric.h"
+#include "pattern-distance.h"
 
 using std::vector;
 using std::array;
 using std::string;
 
-class Metric;
+/*! \class PatternFeatures
+ *  \brief The normalized y values [0, 1] of a PlotPattern.
+ *
+ *  Zero padded to the layout PatternDistance expects, so patterns' features can
+ *  be handed to it, or copied into a block of candidates, as is. Trivially
+ *  copyable and without the pattern's metric or times, so the training and
+ *  screening loops extract and pass these instead of whole patterns (see
+ *  Metric::tryGetFeatures and MetricGrid::tryGetFeatures).
+ *  \tparam RESOLUTION The number of y values.
+ */
+template <size_t RESOLUTION>
+struct PatternFeatures {
+  static constexpr size_t SIZE = PatternDistance::paddedSize(RESOLUTION);
+
+  // 16, operator new doesn't guarantee more.
+  alignas(16) float y[SIZE];
+
+  /**
+   * Sets y to values scaled to [0, 1] between their min and max, all 0 if they
+   * are flat, zero padded.
+   * @param values RESOLUTION values.
+   */
+  void normalize(const double* values) {
+    // Branchless, so it vectorizes.
+    double min = values[0], max = values[0];
+    for (size_t i = 1; i < RESOLUTION; i++) {
+      min = std::min(min, values[i]);
+      max = std::max(max, values[i]);
+    }
+
+    double magnitude = max - min;
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      this->y[i] = magnitude < 0.00000001 ? 0.0f : static_cast<float>((values[i] - min) / magnitude);
+    }
+    std::fill(this->y + RESOLUTION, this->y + SIZE, 0.0f);
+  }
+
+  /**
+   * @param rhs The features to calculate the diff from.
+   * @return The absolute area between the two, same as PlotPattern::getAbsoluteArea.
+   */
+  float getAbsoluteArea(const PatternFeatures<RESOLUTION>& rhs) const {
+    float area;
+    PatternDistance::absoluteArea(this->y, rhs.y, 1, RESOLUTION, &area);
+    return area;
+  }
+};
+
+template <size_t RESOLUTION>
+constexpr size_t PatternFeatures<RESOLUTION>::SIZE;
 
 /*! \class PlotPattern
  *  \brief A pottern that is found inside Metric.
@@ -32,6 +84,21 @@ template <size_t RESOLUTION>
 class PlotPattern {
  public:
   using DATA = array<std::pair<double, double>, RESOLUTION>;
+  using FEATURES = PatternFeatures<RESOLUTION>;
+
+  static_assert(std::is_trivially_copyable<FEATURES>::value, "Features are copied as raw memory.");
+
+  // Length of the normalized y values, padded for PatternDistance.
+  static constexpr size_t PADDED_SIZE = FEATURES::SIZE;
+
+  /**
+   * A flat pattern of no metric, to be extracted into (see Metric::getPattern).
+   */
+  PlotPattern() :
+      _data(),
+      _equalityEpsilon(0.08f) {
+    std::fill(this->_features.y, this->_features.y + PADDED_SIZE, 0.0f);
+  }
 
   /**
    * TODO(jandres): make equalityEpsilon a cli param.
@@ -45,26 +112,14 @@ class PlotPattern {
   PlotPattern(const std::shared_ptr<Metric>& metric,
               const DATA& data,
               float equalityEpsilon = 0.08f) :
-      _metric(metric),
       _data(data),
-      _equalityEpsilon(equalityEpsilon) {
-    this->_min = std::accumulate(
-        data.begin(),
-        data.end(),
-        data.front().first,
-        [](float currentMin, const app::point& p) {
-          if (currentMin > p.first) { return p.first; }
-          return currentMin;
-        });
-
-    this->_max = std::accumulate(
-        data.begin(),
-        data.end(),
-        data.front().first,
-        [](float currentMax, const app::point& p) {
-          if (currentMax < p.first) { return p.first; }
-          return currentMax;
-        });
+      _equalityEpsilon(equalityEpsilon),
+      _metric(metric) {
+    double y[RESOLUTION];
+    for (size_t i = 0; i < RESOLUTION; i++) {
+      y[i] = std::get<0>(data[i]);
+    }
+    this->_features.normalize(y);
   }
 
   /**
@@ -141,13 +196,7 @@ class PlotPattern {
    * @return The accumulative diff all positive. Better for diff not being offseted by negative.
    */
   float getAbsoluteArea(const PlotPattern<RESOLUTION>& rhs) const {
-    float area = 0.0;
-
-    for (size_t i = 0; i < RESOLUTION; i++) {
-      area += std::abs(this->getNormalizeY(i) - rhs.getNormalizeY(i));
-    }
-
-    return area/RESOLUTION;
+    return this->_features.getAbsoluteArea(rhs._features);
   }
 
   /**
@@ -156,13 +205,9 @@ class PlotPattern {
    * @return The accumulative diff, including negative.
    */
   float getArea(const PlotPattern<RESOLUTION>& rhs) const {
-    float area = 0.0;
-
-    for (size_t i = 0; i < RESOLUTION; i++) {
-      area += (this->getNormalizeY(i) - rhs.getNormalizeY(i));
-    }
-
-    return area/RESOLUTION;
+    float area;
+    PatternDistance::area(this->_features.y, rhs._features.y, 1, RESOLUTION, &area);
+    return area;
   }
 
   /**
@@ -171,18 +216,23 @@ class PlotPattern {
    * @return A normalize y value [0, 1]
    */
   float getNormalizeY(size_t index) const {
-    float magnitude = this->_max - this->_min;
-    if (magnitude < 0.00000001f) {
-      return 0.0f;
-    }
-    return (std::get<0>(this->_data.at(index)) - this->_min) / magnitude;
+    return this->_features.y[index];
   }
 
   /**
-   * @return The data associated with this metrics.
+   * Acquires all the normalized y values at once, in the layout PatternDistance
+   * expects.
+   * @param out Output, PADDED_SIZE long. Zero past the RESOLUTION y values.
    */
-  DATA& getData() {
-    return this->_data;
+  void getNormalizeY(float* out) const {
+    std::copy(this->_features.y, this->_features.y + PADDED_SIZE, out);
+  }
+
+  /**
+   * @return The normalized y values, computed once at construction.
+   */
+  const FEATURES& getFeatures() const {
+    return this->_features;
   }
 
   /**
@@ -226,17 +276,6 @@ class PlotPattern {
     return id;
   }
 
-  virtual PlotPattern<RESOLUTION>& operator=(PlotPattern<RESOLUTION>& rhs) {
-    if (this == &rhs) {
-      return *this;
-    }
-
-    this->_data = rhs._data;
-    this->_equalityEpsilon = rhs._equalityEpsilon;
-    this->_metric = rhs._metric;
-    return *this;
-  }
-
   /**
    * Given a metricName return the index of the pattern with the associated metricName.
    * @param patterns A vector of patterns.
@@ -253,22 +292,17 @@ class PlotPattern {
     }
   }
 
-  rl::spFloatVector getGradientDescentParameters() {
-    rl::spFloatVector rv(new rl::floatVector());
-
-    for (size_t i = 0; i < RESOLUTION; i++) {
-      rv->push_back(this->getNormalizeY(i));
-    }
-
+  rl::spFloatVector getGradientDescentParameters() const {
+    rl::spFloatVector rv(new rl::floatVector(this->_features.y, this->_features.y + RESOLUTION));
     rv->push_back(static_cast<float>(this->_metric->getMetricIndex()));
     return rv;
   }
 
  protected:
+  FEATURES _features;
   DATA _data;
   float _equalityEpsilon;
   std::shared_ptr<Metric> _metric;
-  float _min, _max;
 };
 
 template <size_t RESOLUTION>
@@ -281,6 +315,9 @@ std::ostream& operator <<(std::ostream& stream, const PlotPattern<RESOLUTION>& p
   return stream;
 }
 
+template <size_t RESOLUTION>
+constexpr size_t PlotPattern<RESOLUTION>::PADDED_SIZE;
+
 using PlotPatternSpecialized = PlotPattern<app::PATTERN_SIZE>;
 using STATE = PlotPattern<app::PATTERN_SIZE>;
 using ACTION = STATE;
\ No newline at end of file
@@ -0,0 +1,298 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <rl>
+
+#include "declares.h"
+#include "half-float.h"
+#include "plot-pattern.h"
+#include "sparse-weights.h"
+#include "tile-coding.h"
+
+/*! \class QModel
+ *  \brief Tile coded, one step Q-learning model that can be trained by many threads at once.
+ *
+ *  Stands in for rl::algorithm::QLearningGD, whose eligibility traces make every
+ *  update depend on the one before it. Here an update only touches the weights of
+ *  the updated state-action's tiles, so threads training different metrics
+ *  (whose metric index is one of the tile coded dimensions) rarely touch the same
+ *  weight.
+ *
+ *  update() can be called from many threads without locks (Hogwild): weights are
+ *  relaxed atomics, and when two threads update the same weight at once one of
+ *  the increments may be lost. For results that don't depend on thread timing,
+ *  an update can instead be split in two: getIncrement() while no weight changes,
+ *  then addIncrement() from threads owning disjoint weight ranges.
+ *
+ *  Weights are either a dense table of tileCode.getSize() weights, or, when
+ *  only a small part of the tiles is touched, SparseWeights holding the touched
+ *  ones. Sparse weights must be made room for with reserveIncrements() before
+ *  addIncrement() is called from several threads. The dense table can also hold
+ *  half precision weights, for half the memory: each is stored as its difference
+ *  from the initial weight, so the small early updates keep their precision,
+ *  and updates are made in float then rounded back.
+ */
+class QModel {
+ public:
+  enum class Storage {
+    DENSE,
+    SPARSE,
+    HALF  // Dense, half precision.
+  };
+
+  /**
+   * @param tileCode Maps a state-action (state parameters followed by action
+   *                 parameters) to one weight per tiling. Not copied.
+   * @param stepSize The learning rate.
+   * @param discountRate How much the next state-action's value counts.
+   * @param initialValue The value of every state-action before training.
+   * @param storage How the weights are stored.
+   * @param sparseCapacity Number of weights the sparse storage has room for before growing.
+   */
+  QModel(const rl::coding::TileCode &tileCode,
+         rl::FLOAT stepSize,
+         rl::FLOAT discountRate,
+         rl::FLOAT initialValue,
+         Storage storage = Storage::DENSE,
+         size_t sparseCapacity = 0);
+
+  /**
+   * @param state State parameters.
+   * @param action Action parameters.
+   * @return The state-action's value. Thread safe.
+   */
+  rl::FLOAT getValue(const rl::floatVector &state, const rl::floatVector &action) const;
+
+  /**
+   * Moves the state-action's value toward reward + discountRate * value(nextState, action).
+   * Thread safe, see the class description.
+   * @param state State parameters.
+   * @param action Action parameters, also the action taken in nextState.
+   * @param reward Reward of taking action in state.
+   * @param nextState State parameters of the state the action leads to.
+   */
+  void update(const rl::floatVector &state,
+              const rl::floatVector &action,
+              rl::FLOAT reward,
+              const rl::floatVector &nextState);
+
+  /**
+   * @param state State parameters.
+   * @param action Action parameters.
+   * @return Index of the state-action's weight in each tiling.
+   */
+  rl::FEATURE_VECTOR getFeatureVector(const rl::floatVector &state, const rl::floatVector &action) const;
+
+  /**
+   * Same as getFeatureVector(*pattern.getGradientDescentParameters(), *app::goalAction),
+   * without allocating when the tile coding is an app::PATTERN_TILE_CODE.
+   * @param pattern The state.
+   * @param features Output, getNumTilings() weight indices.
+   */
+  void getFeatures(const PlotPattern<app::PATTERN_SIZE> &pattern, size_t* features) const;
+
+  /**
+   * Same as getFeatures(pattern, features), from the pattern's normalized y values
+   * and its metric's index.
+   * @param patternFeatures The state's normalized y values.
+   * @param metricIndex The state's Metric::getMetricIndex().
+   * @param features Output, getNumTilings() weight indices.
+   */
+  void getFeatures(const PatternFeatures<app::PATTERN_SIZE> &patternFeatures,
+                   size_t metricIndex,
+                   size_t* features) const;
+
+  /**
+   * @param features A state-action's features.
+   * @return The state-action's value. Thread safe.
+   */
+  rl::FLOAT getValue(const rl::FEATURE_VECTOR &features) const {
+    return this->getValue(features.data());
+  }
+
+  /**
+   * @param features A state-action's getNumTilings() features.
+   * @return The state-action's value. Thread safe.
+   */
+  rl::FLOAT getValue(const size_t* features) const;
+
+  /**
+   * First half of update().
+   * @param features Features of the updated state-action.
+   * @param reward Reward of taking the action in the state.
+   * @param nextValue Value of the next state-action.
+   * @return What to add to each of the features' weights.
+   */
+  rl::FLOAT getIncrement(const rl::FEATURE_VECTOR &features, rl::FLOAT reward, rl::FLOAT nextValue) const {
+    return this->getIncrement(features.data(), reward, nextValue);
+  }
+
+  /**
+   * @see getIncrement
+   * @param features The updated state-action's getNumTilings() features.
+   */
+  rl::FLOAT getIncrement(const size_t* features, rl::FLOAT reward, rl::FLOAT nextValue) const;
+
+  /**
+   * Second half of update().
+   * @param feature Index of the weight.
+   * @param increment From getIncrement.
+   */
+  void addIncrement(size_t feature, rl::FLOAT increment) {
+    switch (this->_storage) {
+      case Storage::DENSE: {
+        auto &weight = this->_weights[feature];
+        weight.store(weight.load(std::memory_order_relaxed) + increment, std::memory_order_relaxed);
+        break;
+      }
+      case Storage::SPARSE:
+        this->_sparseWeights->add(feature, increment);
+        break;
+      case Storage::HALF: {
+        auto &delta = this->_halfWeights[feature];
+        rl::FLOAT updated = app::fromHalf(delta.load(std::memory_order_relaxed)) + increment;
+        delta.store(app::toHalf(updated), std::memory_order_relaxed);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Makes room for count addIncrement() calls. Not thread safe.
+   * @param count Number of addIncrement() calls.
+   */
+  void reserveIncrements(size_t count) {
+    if (this->_sparseWeights) {
+      this->_sparseWeights->reserve(count);
+    }
+  }
+
+  /**
+   * Forgets the training: every state-action's value is back to initialValue.
+   * Not thread safe.
+   */
+  void reset();
+
+  /**
+   * @param feature Index of the weight.
+   * @return The weight. Thread safe.
+   */
+  rl::FLOAT getWeight(size_t feature) const {
+    switch (this->_storage) {
+      case Storage::SPARSE:
+        return this->_sparseWeights->get(feature);
+      case Storage::HALF:
+        return this->_initialWeight + app::fromHalf(this->_halfWeights[feature].load(std::memory_order_relaxed));
+      default:
+        return this->_weights[feature].load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @param feature Index of the weight.
+   * @param weight The new weight, rounded with half storage. Not thread safe with sparse storage.
+   */
+  void setWeight(size_t feature, rl::FLOAT weight) {
+    switch (this->_storage) {
+      case Storage::DENSE:
+        this->_weights[feature].store(weight, std::memory_order_relaxed);
+        break;
+      case Storage::SPARSE:
+        this->_sparseWeights->set(feature, weight);
+        break;
+      case Storage::HALF:
+        this->_halfWeights[feature].store(app::toHalf(weight - this->_initialWeight), std::memory_order_relaxed);
+        break;
+    }
+  }
+
+  /**
+   * @param indices Output, indices of the weights that training changed, increasing.
+   * @param weights Output, their weights.
+   */
+  void getChangedWeights(std::vector<uint64_t> &indices, std::vector<rl::FLOAT> &weights) const;
+
+  /**
+   * Copies the dense table as stored, a plain copy, so it can be scanned for the
+   * changed weights elsewhere. Nothing is copied for sparse weights.
+   * @param weights Output, the DENSE weights, empty otherwise.
+   * @param halfWeights Output, the HALF weights' differences from getInitialWeight(), empty otherwise.
+   */
+  void copyTable(std::vector<rl::FLOAT> &weights, std::vector<uint16_t> &halfWeights) const;
+
+  /**
+   * @return Whether the weights are SparseWeights.
+   */
+  bool isSparse() const {
+    return this->_storage == Storage::SPARSE;
+  }
+
+  /**
+   * @return How the weights are stored.
+   */
+  Storage getStorage() const {
+    return this->_storage;
+  }
+
+  /**
+   * @return Bytes used by the weights.
+   */
+  size_t getMemorySize() const {
+    switch (this->_storage) {
+      case Storage::SPARSE:
+        return this->_sparseWeights->getMemorySize();
+      case Storage::HALF:
+        return this->_size * sizeof(uint16_t);
+      default:
+        return this->_size * sizeof(rl::FLOAT);
+    }
+  }
+
+  /**
+   * @return Every weight's value before training.
+   */
+  rl::FLOAT getInitialWeight() const {
+    return this->_initialWeight;
+  }
+
+  /**
+   * @return Number of weights.
+   */
+  size_t getSize() const {
+    return this->_size;
+  }
+
+  /**
+   * @return Number of features of a state-action.
+   */
+  size_t getNumTilings() const {
+    return this->_tileCode.getNumTilings();
+  }
+
+  /**
+   * @return The tile coder of the model's tile coding.
+   */
+  app::TileCoder getTileCoder() const {
+    return this->_patternTileCode != nullptr ? app::TileCoder::PATTERN : app::TileCoder::MURMUR;
+  }
+
+ protected:
+  const rl::coding::TileCode &_tileCode;
+  const app::PATTERN_TILE_CODE *_patternTileCode;  // _tileCode, if it is one.
+  rl::FLOAT _stepSize;
+  rl::FLOAT _discountRate;
+  rl::FLOAT _initialValue;
+  rl::FLOAT _initialWeight;  // A state-action's value is the sum of one weight per tiling.
+  size_t _size;
+  Storage _storage;
+  std::unique_ptr<std::atomic<rl::FLOAT>[]> _weights;  // Dense storage.
+  std::unique_ptr<SparseWeights> _sparseWeights;  // Sparse storage.
+  std::unique_ptr<std::atomic<uint16_t>[]> _halfWeights;  // Half storage, difference from _initialWeight.
+};
@@ -0,0 +1,46 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "declares.h"
+
+/*! \class Ranking
+ *  \brief Compares the metric rankings of scores, such as two models' rewards.
+ *
+ *  Metrics are ranked from the highest score to the lowest. Only the top of a
+ *  ranking is reported, so only the top is compared.
+ */
+class Ranking {
+ public:
+  /**
+   * @param values Score of each metric.
+   * @param k Number of metrics to return.
+   * @return Indices of the min(k, values.size()) highest scoring metrics, highest first.
+   *         Ties are ordered by index.
+   */
+  static std::vector<size_t> getTop(const std::vector<rl::FLOAT> &values, size_t k);
+
+  /**
+   * Kendall's tau-b between two scores of the reference's top k metrics.
+   * @param reference Score of each metric, selects the compared metrics.
+   * @param values Other score of each metric, same size as reference.
+   * @param k Number of compared metrics.
+   * @return In [-1, 1]: 1 if values orders the reference's top k like reference
+   *         does, -1 if reversed, 0 if unrelated (or if either score is constant).
+   */
+  static double getKendallTau(const std::vector<rl::FLOAT> &reference,
+                              const std::vector<rl::FLOAT> &values,
+                              size_t k);
+
+  /**
+   * @param a Score of each metric.
+   * @param b Other score of each metric, same size as a.
+   * @param k Number of compared metrics.
+   * @return Fraction of a's top k metrics that are also in b's top k, in [0, 1].
+   */
+  static double getTopOverlap(const std::vector<rl::FLOAT> &a, const std::vector<rl::FLOAT> &b, size_t k);
+};
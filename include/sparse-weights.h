@@ -0,0 +1,122 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <rl>
+
+/*! \class SparseWeights
+ *  \brief Open addressing hash table of the weights that differ from a default.
+ *
+ *  Stands in for a dense weight table when only a small part of the tiles is
+ *  ever touched: memory is proportional to the touched weights instead of the
+ *  tile coding's size. Linear probing over power of 2 slots, kept at most half full.
+ *
+ *  get() and add() can be called from many threads at once, provided no key is
+ *  read or added to by two threads at once, and reserve() made room for the
+ *  added keys beforehand. reserve(), set() and clear() can't.
+ */
+class SparseWeights {
+ public:
+  /**
+   * @param defaultWeight The weight of keys that were never added to.
+   * @param capacity Number of keys that fit before growing.
+   */
+  SparseWeights(rl::FLOAT defaultWeight, size_t capacity);
+
+  /**
+   * @param key The weight's index.
+   * @return The weight.
+   */
+  rl::FLOAT get(uint64_t key) const {
+    size_t slot = this->findSlot(key);
+    uint64_t slotKey = this->_keys[slot].load(std::memory_order_relaxed);
+    return slotKey == key ? this->_values[slot].load(std::memory_order_relaxed) : this->_defaultWeight;
+  }
+
+  /**
+   * Adds increment to the key's weight. No other thread may add to the same key meanwhile.
+   * @param key The weight's index.
+   * @param increment Added to the weight.
+   */
+  void add(uint64_t key, rl::FLOAT increment);
+
+  /**
+   * @param key The weight's index.
+   * @param weight The new weight.
+   */
+  void set(uint64_t key, rl::FLOAT weight);
+
+  /**
+   * Grows the table, if needed, so that count more keys can be added without growing.
+   * @param count Number of keys that may be added.
+   */
+  void reserve(size_t count);
+
+  /**
+   * Every weight is back to the default.
+   */
+  void clear();
+
+  /**
+   * @return Number of keys added.
+   */
+  size_t size() const {
+    return this->_size.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @return Bytes used by the table.
+   */
+  size_t getMemorySize() const {
+    return this->_slotCount * (sizeof(uint64_t) + sizeof(rl::FLOAT));
+  }
+
+  /**
+   * Calls function(key, weight) for every added key, in no particular order.
+   */
+  template <class FUNCTION>
+  void forEach(FUNCTION function) const {
+    for (size_t slot = 0; slot < this->_slotCount; slot++) {
+      uint64_t key = this->_keys[slot].load(std::memory_order_relaxed);
+      if (key != EMPTY) {
+        function(key, this->_values[slot].load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+ protected:
+  static constexpr uint64_t EMPTY = ~0ULL;
+
+  /**
+   * @return The slot holding the key, or the empty slot ending its probe sequence.
+   */
+  size_t findSlot(uint64_t key) const {
+    size_t mask = this->_slotCount - 1;
+    size_t slot = static_cast<size_t>((key * 0x9e3779b97f4a7c15ULL) >> this->_shift) & mask;
+    while (true) {
+      uint64_t slotKey = this->_keys[slot].load(std::memory_order_relaxed);
+      if (slotKey == key || slotKey == EMPTY) {
+        return slot;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  /**
+   * @param slotCount New number of slots, a power of 2.
+   */
+  void rehash(size_t slotCount);
+
+  rl::FLOAT _defaultWeight;
+  size_t _slotCount;
+  unsigned _shift;  // 64 - log2(_slotCount), keeps the hash's high bits.
+  std::unique_ptr<std::atomic<uint64_t>[]> _keys;
+  std::unique_ptr<std::atomic<rl::FLOAT>[]> _values;
+  std::atomic<size_t> _size;
+};
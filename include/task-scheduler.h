@@ -0,0 +1,125 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+/*! \class TaskScheduler
+ *  \brief Work stealing pool of worker threads that runs ranges in parallel.
+ *
+ *  parallelFor splits a range of indices into chunks, and deals each worker's
+ *  deque a contiguous share of them. A worker takes chunks from the front of its
+ *  own deque, in order, and once it runs dry steals from the back of the others',
+ *  so workers that get cheap chunks help the ones stuck with expensive ones.
+ *
+ *  A deque is not lock-free: it is a vector and a front index, guarded by its
+ *  worker's mutex, which both the owner and thieves take for every chunk. Chunks
+ *  are coarse (see getGrainSize), so the locks are rarely contended. The vectors
+ *  are reused from job to job, so a job doesn't allocate once they have grown to
+ *  its chunk count.
+ *
+ *  parallelFor must not be called from inside a task.
+ */
+class TaskScheduler {
+ public:
+  // Runs the indices [begin, end).
+  using RANGE_TASK = std::function<void(size_t begin, size_t end)>;
+
+  /*! \class WorkerStats
+   *  \brief What a worker did across all parallelFor calls so far.
+   */
+  struct WorkerStats {
+    double busySeconds = 0;  // Running tasks.
+    double idleSeconds = 0;  // Inside a parallelFor, out of work while others still ran.
+    size_t taskCount = 0;    // Chunks run.
+    size_t stolenCount = 0;  // Chunks run that were stolen from another worker.
+  };
+
+  /**
+   * Starts the workers.
+   * @param workerCount Number of worker threads, at least 1.
+   */
+  explicit TaskScheduler(size_t workerCount);
+
+  /**
+   * Stops and joins the workers.
+   */
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  /**
+   * Runs task over [0, count) on the workers, and returns once all of it ran.
+   * @param count Number of indices.
+   * @param grainSize Indices per chunk, at least 1.
+   * @param task Called once per chunk, concurrently.
+   * @throw The first exception a task threw. The chunks left once it was thrown
+   *        are skipped.
+   */
+  void parallelFor(size_t count, size_t grainSize, const RANGE_TASK& task);
+
+  /**
+   * @param count Number of indices.
+   * @return A grain size giving every worker several chunks to balance with.
+   */
+  size_t getGrainSize(size_t count) const;
+
+  size_t getWorkerCount() const {
+    return this->_workers.size();
+  }
+
+  /**
+   * @return Stats of each worker. Not to be called during parallelFor.
+   */
+  vector<WorkerStats> getStats() const;
+
+ protected:
+  struct Chunk {
+    size_t begin;
+    size_t end;
+  };
+
+  struct Worker {
+    std::mutex mutex;  // Guards chunks and front.
+    vector<Chunk> chunks;  // The deque is [front, chunks.size()).
+    size_t front = 0;
+    std::thread thread;
+    WorkerStats stats;
+    double jobBusySeconds = 0;  // Busy time in the current parallelFor.
+  };
+
+  /**
+   * A worker's loop, waits for a job, runs chunks until there are none left.
+   */
+  void run(size_t worker);
+
+  /**
+   * Takes the next chunk of the worker's own deque, or steals one.
+   * @return false if every deque is empty.
+   */
+  bool takeChunk(size_t worker, Chunk& chunk, bool& stolen);
+
+  vector<std::unique_ptr<Worker>> _workers;
+
+  std::mutex _mutex;  // Guards the fields below.
+  std::condition_variable _jobStarted;
+  std::condition_variable _jobFinished;
+  size_t _generation;      // Incremented for every job.
+  size_t _activeWorkers;   // Workers not done with the current job.
+  bool _stopping;
+  const RANGE_TASK* _task;
+  std::exception_ptr _error;
+  std::atomic<bool> _failed;
+};
@@ -0,0 +1,94 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rl>
+
+#include "declares.h"
+#include "metric.h"
+#include "pattern-tile-code.h"
+
+namespace app {
+
+// Tilings of the state-action tile coding, offset from each other.
+const size_t TILING_COUNT = 10;
+
+// Tiles per tiling and metric index sparse weights start with room for: a metric's
+// update touches one tile per tiling, so this covers its first 16 windows before
+// the table grows.
+const size_t SPARSE_TILES_PER_METRIC = 16;
+
+using PATTERN_TILE_CODE = PatternTileCode<PATTERN_SIZE, TILING_COUNT>;
+
+/**
+ * The tile coding of a pattern's state-action. They hash tiles differently, so a
+ * model trained with one can't be read with the other.
+ */
+enum class TileCoder {
+  PATTERN,  // PATTERN_TILE_CODE.
+  MURMUR    // rl::coding::TileCodeMurMur, the default.
+};
+
+/**
+ * @param name One of "pattern" or "murmur".
+ * @return The tile coder with the given name.
+ * @throw std::domain_error if there is no tile coder with the given name.
+ */
+TileCoder parseTileCoder(const std::string &name);
+
+/**
+ * @return The name of the tile coder, as accepted by parseTileCoder.
+ */
+std::string getTileCoderName(TileCoder tileCoder);
+
+/**
+ * @param tileCode A tile coding made by createTileCode.
+ * @return The tile coder it was made with.
+ */
+TileCoder getTileCoder(const rl::coding::TileCode &tileCode);
+
+/**
+ * @param metrics The trained metrics.
+ * @return Number of tiles of the metric index dimension, one per metric index up
+ *         to the largest trained one.
+ */
+size_t getMetricDimension(const std::vector<std::shared_ptr<Metric>> &metrics);
+
+/**
+ * The tile coding hashes tiles into a table of weights. Every metric has its own
+ * tiles (the metric index is a dimension), so the number of touched tiles grows
+ * with the number of metrics times the number of distinct patterns per metric.
+ * @param metricDimension See getMetricDimension.
+ * @param tilesPerMetric Expected number of distinct tiles one metric's patterns touch, per tiling.
+ * @return A power of 2 table size keeping the expected tiles at most half of the table.
+ */
+size_t getTableSize(size_t metricDimension, size_t tilesPerMetric);
+
+/**
+ * Initial capacity of a QModel's sparse weights, counted the way getTableSize
+ * counts the expected tiles, with SPARSE_TILES_PER_METRIC tiles per metric.
+ * @param metricDimension See getMetricDimension.
+ * @param tableSize Size of the hashed weight table, no more keys than this are stored.
+ * @return Number of keys the sparse weights make room for.
+ */
+size_t getSparseCapacity(size_t metricDimension, size_t tableSize);
+
+/**
+ * @param metricDimension See getMetricDimension.
+ * @param tableSize Size of the hashed weight table.
+ * @param tileCoder Which tile coding.
+ * @return The tile coding of a pattern's state-action: its PATTERN_SIZE normalized
+ *         y values, its metric index, then the action.
+ * @throw std::domain_error if tableSize is not a power of 2, with TileCoder::PATTERN.
+ */
+std::unique_ptr<rl::coding::TileCode> createTileCode(size_t metricDimension,
+                                                     size_t tableSize,
+                                                     TileCoder tileCoder = TileCoder::MURMUR);
+
+}  // namespace app
@@ -0,0 +1,156 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "declares.h"
+#include "tile-coding.h"
+#include "window-sampler.h"
+
+using std::vector;
+using std::string;
+
+class QModel;
+
+/*! \class TrainCheckpoint
+ *  \brief Everything needed to continue an interrupted app::train.
+ *
+ *  Windows are counter based (see WindowSampler), so the iteration counter and
+ *  the seed stand for the random number generator's state. Only the weights
+ *  that training changed are stored, which is a small part of the table.
+ *
+ *  Layout (native endianness):
+ *  - Header.
+ *  - activeCount uint64_t, the indices of the metrics still trained.
+ *  - weightCount uint64_t, the indices of the changed weights, increasing.
+ *  - weightCount floats, their values.
+ */
+class TrainCheckpoint {
+ public:
+  static const uint32_t VERSION = 3;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t sampler;  // app::Sampler.
+    uint64_t seed;
+    uint64_t iterationCount;
+    uint64_t iterationsDone;
+    uint64_t round;  // Successive halving round.
+    uint64_t metricCount;
+    uint64_t modelSize;
+    uint64_t numTilings;
+    uint32_t tileCoder;  // app::TileCoder, since version 3.
+    uint32_t reserved;
+    uint64_t activeCount;
+    uint64_t weightCount;
+  };
+
+  uint64_t seed = 0;
+  app::Sampler sampler = app::Sampler::UNIFORM;
+  size_t iterationCount = 0;
+  size_t iterationsDone = 0;
+  size_t round = 0;
+  size_t metricCount = 0;
+  vector<size_t> activeMetrics;
+
+  /**
+   * Copies the model's weights: a plain copy of a dense table, which write() then
+   * scans for the changed weights, on CheckpointWriter's thread; the changed
+   * weights of sparse ones.
+   * @param model The trained model. Must not be updated meanwhile.
+   */
+  void capture(const QModel &model);
+
+  /**
+   * Resets the model to the captured weights.
+   * @param model A model with the same tile coding as the captured one.
+   * @throw std::runtime_error if the model's size or tile coder doesn't match.
+   */
+  void restore(QModel &model) const;
+
+  /**
+   * Writes the checkpoint next to fileName, then renames it over fileName, so
+   * fileName always holds a whole checkpoint.
+   * @param fileName The file to write.
+   * @throw std::runtime_error if the file can't be written.
+   */
+  void write(const string &fileName) const;
+
+  /**
+   * @param fileName A file written by TrainCheckpoint::write.
+   * @return The checkpoint.
+   * @throw std::runtime_error if the file can't be read or is not a valid checkpoint.
+   */
+  static TrainCheckpoint read(const string &fileName);
+
+ protected:
+  /**
+   * Calls f(index, weight) for each weight training changed, in increasing index order.
+   */
+  template <class F>
+  void forEachChangedWeight(const F &f) const;
+
+  uint64_t _modelSize = 0;
+  uint64_t _numTilings = 0;
+  app::TileCoder _tileCoder = app::TileCoder::MURMUR;
+  float _initialWeight = 0;
+  vector<float> _table;  // Captured dense table.
+  vector<uint16_t> _halfTable;  // Captured half table, see QModel::copyTable.
+  vector<uint64_t> _weightIndices;  // The changed weights, if no table was captured.
+  vector<float> _weightValues;
+};
+
+/*! \class CheckpointWriter
+ *  \brief Writes checkpoints on a background thread, so training only waits for
+ *         TrainCheckpoint::capture, a copy of the weights.
+ *
+ *  If a checkpoint is submitted while the previous one is still being written,
+ *  only the newest pending one is written.
+ */
+class CheckpointWriter {
+ public:
+  /**
+   * @param fileName The file the checkpoints are written to.
+   */
+  explicit CheckpointWriter(const string &fileName);
+
+  /**
+   * Waits for the pending checkpoint to be written. Write errors are lost, call wait() to get them.
+   */
+  ~CheckpointWriter();
+
+  /**
+   * @param checkpoint Written in the background.
+   * @throw std::runtime_error if writing a previous checkpoint failed.
+   */
+  void write(TrainCheckpoint checkpoint);
+
+  /**
+   * Waits for the pending checkpoint to be written.
+   * @throw std::runtime_error if writing a checkpoint failed.
+   */
+  void wait();
+
+ protected:
+  void run();
+
+  string _fileName;
+  std::mutex _mutex;
+  std::condition_variable _changed;
+  std::unique_ptr<TrainCheckpoint> _pending;
+  bool _writing;
+  bool _stopping;
+  std::exception_ptr _error;
+  std::thread _thread;
+};
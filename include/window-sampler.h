@@ -0,0 +1,84 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "declares.h"
+#include "counter-random.h"
+
+namespace app {
+
+/**
+ * How the training windows' start times are spread over the metrics' time range.
+ */
+enum class Sampler {
+  UNIFORM,     // Independent, uniformly random starts.
+  STRATIFIED,  // One random start in each of iterationCount equal strata, strata in golden ratio order.
+  SOBOL        // Randomly shifted Sobol (base 2 van der Corput) sequence.
+};
+
+/**
+ * @param name One of "uniform", "stratified" or "sobol".
+ * @return The sampler with the given name.
+ * @throw std::domain_error if there is no sampler with the given name.
+ */
+Sampler parseSampler(const std::string &name);
+
+/**
+ * @return The name of the sampler, as accepted by parseSampler.
+ */
+std::string getSamplerName(Sampler sampler);
+
+}  // namespace app
+
+/*! \class WindowSampler
+ *  \brief Start times of the training windows.
+ *
+ *  Whatever the sampler, the start of iteration i is a pure function of
+ *  (seed, i), so iterations can be sampled in any order or split across threads.
+ *  Stratified and Sobol starts cover the time range evenly: any prefix of n
+ *  iterations leaves no gap much larger than range / n, where uniform starts
+ *  cluster and leave gaps of about range * log(n) / n.
+ */
+class WindowSampler {
+ public:
+  /**
+   * @param sampler How the starts are spread.
+   * @param seed Selects the starts.
+   * @param iterationCount Number of iterations, the number of strata for Sampler::STRATIFIED.
+   * @param timeBegin The earliest start (unix time stamp).
+   * @param timeEnd The latest start (unix time stamp), at least timeBegin.
+   */
+  WindowSampler(app::Sampler sampler,
+                uint64_t seed,
+                size_t iterationCount,
+                app::time timeBegin,
+                app::time timeEnd);
+
+  /**
+   * @param iteration Iteration index, less than iterationCount.
+   * @return Start time of the iteration's window, in [timeBegin, timeEnd].
+   */
+  app::time getTimeBegin(size_t iteration) const;
+
+  /**
+   * @param fraction A fraction of 2^64.
+   * @param range Number of values.
+   * @return floor(fraction / 2^64 * range), in [0, range), without overflow.
+   */
+  static uint64_t scale(uint64_t fraction, uint64_t range);
+
+ protected:
+  app::Sampler _sampler;
+  CounterRandom _random;
+  size_t _iterationCount;
+  app::time _timeBegin;
+  uint64_t _range;  // Number of possible starts.
+  uint64_t _strideStep;  // Stratified: coprime to _iterationCount, orders the strata.
+  uint64_t _strideOffset;
+  uint64_t _sobolShift;  // Sobol: random digital shift.
+};
@@ -9,6 +9,10 @@
 #include <ctime>
 #include <map>
 #include <memory>
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <algorithm>
 
 #include <rl>
 
@@ -20,29 +24,34 @@ using json = nlohmann::json;
 const string appName = "analytic-engine-cli";
 
 int main(int argc, char** argv) {
-  if (argc < 3) {
-    std::cerr << ("Terminal format is \"./" + appName + " <*.json> <*.json>\".") << std::endl;
-    exit(1);
+  if (argc == 4 && string(argv[1]) == "convert") {
+    try {
+      app::convertMetrics(argv[2], argv[3]);
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+    return 0;
   }
 
-  std::string metricsFileName(argv[1]);
-  std::string configFileName(argv[2]);
-
-  std::ifstream metricsFileStream(metricsFileName);
-  if (!metricsFileStream.is_open()) {
-    std::cerr << "Problem opening metric file. Probably does not exist." << std::endl;
+  bool scoreOnly = argc == 4 && string(argv[1]) == "score";
+  bool resume = !scoreOnly && argc == 4 && string(argv[3]) == "--resume";
+  if (argc < 3 || (argc > 3 && !resume && !scoreOnly)) {
+    std::cerr << ("Terminal format is \"./" + appName + " <metrics> <*.json> [--resume]\", "
+                  "\"./" + appName + " score <metrics> <*.json>\" or "
+                  "\"./" + appName + " convert <*.json> <metrics>\".") << std::endl;
     exit(1);
   }
 
+  std::string metricsFileName(argv[scoreOnly ? 2 : 1]);
+  std::string configFileName(argv[scoreOnly ? 3 : 2]);
+
   std::ifstream configFileStream(configFileName);
   if (!configFileStream.is_open()) {
     std::cerr << "Problem opening config file. Probably does not exist." << std::endl;
     exit(1);
   }
 
-  std::string metricSFileString((std::istreambuf_iterator<char>(metricsFileStream)), std::istreambuf_iterator<char>());
-  auto metricSJSON = json::parse(metricSFileString);
-
   std::string configFileString((std::istreambuf_iterator<char>(configFileStream)), std::istreambuf_iterator<char>());
   auto configJSON = json::parse(configFileString);
 
@@ -54,8 +63,93 @@ int main(int argc, char** argv) {
   float stepSize = configJSON["reinforcementLearning"]["stepSize"];
   float discountRate = configJSON["reinforcementLearning"]["discountRate"];
   string resultFile = configJSON["resultFile"];
+  json timeGridJSON = configJSON.count("timeGrid") ? configJSON["timeGrid"] : json::object();
+  app::time timeGridStep = timeGridJSON.value("step", 0);
+  size_t timeGridMaxBytes =
+      timeGridJSON.value("maxMegabytes", MetricGrid::DEFAULT_MAX_BYTES / (1024 * 1024)) * 1024 * 1024;
+  uint64_t seed = configJSON.count("seed") ? configJSON["seed"].get<uint64_t>() : std::random_device()();
+  string checkpointFile = configJSON.count("checkpoint") ? configJSON["checkpoint"].value("file", "") : "";
+  size_t checkpointInterval = configJSON.count("checkpoint") ? configJSON["checkpoint"].value("interval", 100) : 100;
+  size_t threadCount = configJSON.value("threads", 0);
+  if (threadCount == 0) {
+    threadCount = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  app::Interpolation trainingInterpolation;
+  app::Interpolation scoringInterpolation;
+  app::Sampler sampler;
+  app::Learner learner;
+  try {
+    sampler = app::parseSampler(configJSON.value("sampler", "uniform"));
+    learner = app::parseLearner(configJSON.value("learner", "qLearningGD"));
+    json interpolationJSON = configJSON.count("interpolation") ? configJSON["interpolation"] : json::object();
+    trainingInterpolation = app::parseInterpolation(interpolationJSON.value("training", "spline"));
+    scoringInterpolation = app::parseInterpolation(interpolationJSON.value("scoring", "spline"));
+  } catch(exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+
+  // rl's agent is trained one update after the other, only the td0 learner's QModel has these.
+  if (learner != app::Learner::TD0 && !scoreOnly) {
+    for (const char *key : {"checkpoint", "modelFile", "earlyStopping", "successiveHalving",
+                            "convergenceReport", "quantizationReport"}) {
+      if (configJSON.count(key)) {
+        std::cerr << "\"" << key << "\" needs \"learner\": \"td0\"." << std::endl;
+        exit(1);
+      }
+    }
+    if (resume) {
+      std::cerr << "--resume needs \"learner\": \"td0\"." << std::endl;
+      exit(1);
+    }
+  }
 
-  auto metrics = Metric::parseMetrics(metricSJSON);
+  // Continue the interrupted run with the checkpoint's seed, the windows it was trained on.
+  TrainCheckpoint checkpoint;
+  if (resume) {
+    try {
+      if (checkpointFile.empty()) {
+        throw std::runtime_error("--resume needs \"checkpoint\": {\"file\": ...} in the config.");
+      }
+      checkpoint = TrainCheckpoint::read(checkpointFile);
+      if (checkpoint.sampler != sampler) {
+        throw std::runtime_error("The checkpoint was written with another sampler.");
+      }
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+    seed = checkpoint.seed;
+    std::cout << "Resuming from iteration " << checkpoint.iterationsDone << "." << std::endl;
+  }
+
+  vector<shared_ptr<Metric>> metrics;
+  try {
+    metrics = app::loadMetrics(metricsFileName);
+  } catch(exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+
+  if (scoreOnly) {
+    try {
+      auto modelStore = ModelStore::open(configJSON["modelFile"]);
+      TaskScheduler scheduler(threadCount);
+      app::scoreWithModel(*modelStore,
+                          metrics,
+                          goalMetric,
+                          goalPatternTimeBegin,
+                          goalPatternTimeEnd,
+                          scoringInterpolation,
+                          &scheduler,
+                          resultFile);
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+    return 0;
+  }
 
   auto minMaxMetricTime = Metric::getMinMaxTime(metrics);
 
@@ -73,11 +167,17 @@ int main(int argc, char** argv) {
   std::cout << "Goal pattern duration (Max pattern time - Min pattern time): "
             << goalPatternTimeDuration << std::endl;
 
+  TaskScheduler scheduler(threadCount);
+
+  app::PatternStatusCounts goalTimeCounts;
   vector<rl::spState<STATE>> patterns =
       Metric::getPatternsFromMetrics<app::PATTERN_SIZE>(
           metrics,
           goalPatternTimeBegin,
-          goalPatternTimeEnd);
+          goalPatternTimeEnd,
+          scoringInterpolation,
+          &scheduler,
+          &goalTimeCounts);
 
   // Since Metric::getPatternsFromMetrics filters out metrics that can't span
   // the whole [goalPatternTimeBegin, goalPatternTimeEnd], thus we can acquire
@@ -89,6 +189,7 @@ int main(int argc, char** argv) {
 
   std::cerr << "Metric count with invalid resolution: "
             << metrics.size() - patterns.size()
+            << " (" << goalTimeCounts.getRejectionSummary() << ")"
             << std::endl;
   std::cout << "Valid metrics: "
             << patterns.size()
@@ -107,55 +208,253 @@ int main(int argc, char** argv) {
 
   auto goalState = patterns[goalPatternIndex];
 
-  // Setup policy.
-  rl::policy::EpsilonGreedy<rl::floatVector, rl::floatVector> policy(1.0F);
-  // Setup tile coding.
-  vector <rl::coding::DimensionInfo<rl::FLOAT>> dimensionalInfoVector = {
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y1
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y2
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y3
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y4
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y5
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y6
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y7
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y8
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y9
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10),  // y10
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 11042.0F, 11043, 0.0F),  // Metrics that will lead to goalState.
-      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 0.0F, 1, 0.0F),  // Metrics that will lead to goalState.
-      //rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 11042.0F, 11043, 0.0F),  // Metrics that will lead to goalState.
+  // The pre-screen only narrows down the metrics that are trained, every valid metric is scored.
+  decltype(patterns) trainedPatterns = patterns;
+  decltype(filteredMetrics) trainedMetrics = filteredMetrics;
+  if (configJSON.count("preScreen")) {
+    json screenJSON = configJSON["preScreen"];
+    app::ScreenOptions screenOptions;
+    screenOptions.windowCount = screenJSON.value("windowCount", 20);
+    screenOptions.topK = screenJSON.value("topK", 0);
+    screenOptions.maxArea = screenJSON.value("maxArea", -1.0);
+
+    app::TrainOptions screenTrainOptions;
+    screenTrainOptions.interpolation = trainingInterpolation;
+    screenTrainOptions.scheduler = &scheduler;
+    screenTrainOptions.seed = seed;
+    screenTrainOptions.sampler = sampler;
+    auto kept = app::screenMetrics(filteredMetrics,
+                                   goalState,
+                                   minMaxMetricTime.first,
+                                   minMaxMetricTime.second,
+                                   screenOptions,
+                                   screenTrainOptions);
+
+    trainedPatterns.clear();
+    trainedMetrics.clear();
+    for (auto k : kept) {
+      trainedPatterns.push_back(patterns[k]);
+      trainedMetrics.push_back(filteredMetrics[k]);
+    }
+    std::cout << "Pre-screen kept " << kept.size() << " of " << patterns.size() << " metrics for training, screened out "
+              << patterns.size() - kept.size() << ". Every metric is still scored." << std::endl;
+  }
+
+  // Setup tile coding, sized for the metrics that are scored.
+  json tileCodingJSON = configJSON.count("tileCoding") ? configJSON["tileCoding"] : json::object();
+  size_t metricDimension = app::getMetricDimension(filteredMetrics);
+  size_t tilesPerMetric = tileCodingJSON.value("tilesPerMetric", 1024);
+  bool isSparse = tileCodingJSON.value("sparse", false);
+  string weightPrecision = tileCodingJSON.value("weights", "float");
+  app::TileCoder tileCoder;
+  try {
+    tileCoder = app::parseTileCoder(tileCodingJSON.value("coder", "murmur"));
+  } catch(exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+  if (weightPrecision != "float" && weightPrecision != "half") {
+    std::cerr << "Unknown weights \"" << weightPrecision << "\", expected \"float\" or \"half\"." << std::endl;
+    exit(1);
+  }
+  if (isSparse && weightPrecision == "half") {
+    std::cerr << "Half precision weights need the dense table, \"sparse\" must be false." << std::endl;
+    exit(1);
+  }
+  if (learner != app::Learner::TD0 && (isSparse || weightPrecision == "half")) {
+    std::cerr << "Sparse and half precision weights need \"learner\": \"td0\"." << std::endl;
+    exit(1);
+  }
+  QModel::Storage storage = isSparse ? QModel::Storage::SPARSE :
+      weightPrecision == "half" ? QModel::Storage::HALF : QModel::Storage::DENSE;
+  // The same table for every storage, so a model hashes its tiles alike whichever stores it.
+  size_t tableSize = app::getTableSize(metricDimension, tilesPerMetric);
+  auto tileCode = app::createTileCode(metricDimension, tableSize, tileCoder);
+
+  std::unique_ptr<MetricGrid> grid;
+  if (timeGridStep > 0) {
+    std::cout << "Resampling metrics onto a " << timeGridStep << "s time grid." << std::endl;
+    try {
+      grid.reset(new MetricGrid(
+          trainedMetrics, minMaxMetricTime.first, minMaxMetricTime.second, timeGridStep, timeGridMaxBytes));
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+  }
+
+  app::TrainOptions trainOptions;
+  trainOptions.interpolation = trainingInterpolation;
+  trainOptions.grid = grid.get();
+  trainOptions.scheduler = &scheduler;
+  trainOptions.seed = seed;
+  trainOptions.sampler = sampler;
+  std::cout << "Seed: " << seed << std::endl;
+
+  auto printTrainSummary = [iterationCount](const app::TrainSummary& trainSummary) {
+    std::cout << "Trained " << trainSummary.iterations << " of " << iterationCount << " iterations in "
+              << trainSummary.seconds << "s, " << trainSummary.updateCount << " metric updates." << std::endl;
+    if (trainSummary.stoppedEarly && trainSummary.iterations > 0) {
+      double secondsPerIteration = trainSummary.seconds / trainSummary.iterations;
+      std::cout << "Stopped early, the ranking was stable. Saved about "
+                << secondsPerIteration * (iterationCount - trainSummary.iterations) << "s." << std::endl;
+    }
+    std::cout << "Skipped " << trainSummary.goalPatterns.getRejectedCount() << " of "
+              << trainSummary.goalPatterns.getTotal() << " windows without a goal pattern ("
+              << trainSummary.goalPatterns.getRejectionSummary() << ")." << std::endl;
+    size_t extractionCount = trainSummary.patterns.getTotal();
+    std::cout << "Rejected " << trainSummary.patterns.getRejectedCount() << " of " << extractionCount
+              << " pattern extractions ("
+              << (extractionCount > 0 ? 100.0 * trainSummary.patterns.getRejectedCount() / extractionCount : 0.0)
+              << "%: " << trainSummary.patterns.getRejectionSummary() << ")." << std::endl;
+#if defined(COUNT_ALLOCATIONS)
+    std::cout << "Heap allocations after the first window: " << trainSummary.steadyStateAllocations << std::endl;
+#endif
   };
 
+  // Get the reward for each metrics.
+  vector<rl::FLOAT> rewards;
+  if (learner == app::Learner::Q_LEARNING_GD) {
+    // Setup policy.
+    rl::policy::EpsilonGreedy<rl::floatVector, rl::floatVector> policy(1.0F);
+
+    std::cout << "Allocating Memory." << std::endl;
+    rl::algorithm::QLearningGD qLearning(*tileCode, stepSize, discountRate, app::TRACE_DECAY, policy);
+    std::cout << "Finished Allocating Memory." << std::endl;
+
+    rl::spActionSet<rl::floatVector> actions({ app::goalAction });
+    auto actionSet = rl::ActionSet<rl::floatVector>(actions);
+    qLearning.setDefaultStateActionValue(initialReward);
+    rl::AgentSupervised<rl::floatVector, rl::floatVector> agent(actionSet, qLearning);
+
+    std::cout << "Training on a single thread." << std::endl;
+    try {
+      printTrainSummary(app::train(iterationCount,
+                                   trainedMetrics,
+                                   goalState,
+                                   agent,
+                                   minMaxMetricTime.first,
+                                   minMaxMetricTime.second,
+                                   trainOptions));
+    } catch(const char* e) {
+      std::cerr << e << std::endl;
+      exit(1);
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+
+    rewards = app::score(patterns, qLearning);
+    app::serializeResult(resultFile, patterns, rewards, goalState);
+    return 0;
+  }
+
   std::cout << "Allocating Memory." << std::endl;
-  rl::coding::TileCodeMurMur tileCode(dimensionalInfoVector, 10, 600000000);  // Setup tile coding with 10 offsets.
-  rl::algorithm::QLearningGD qLearning(tileCode, stepSize, discountRate, 0.9F, policy);
-  std::cout << "Finished Allocating Memory." << std::endl;
+  QModel model(*tileCode,
+               stepSize,
+               discountRate,
+               initialReward,
+               storage,
+               app::getSparseCapacity(metricDimension, tableSize));
+  std::cout << "Finished Allocating Memory: " << model.getMemorySize() / (1024.0 * 1024.0) << "MB for "
+            << tileCode->getSize() << " " << (isSparse ? "sparse" : "dense " + weightPrecision) << " weights."
+            << std::endl;
 
-  rl::spActionSet<rl::floatVector> actions({ app::goalAction });
-  auto actionSet = rl::ActionSet<rl::floatVector>(actions);
-  qLearning.setDefaultStateActionValue(initialReward);
-  rl::AgentSupervised<rl::floatVector, rl::floatVector> agent(actionSet, qLearning);
+  if (resume) {
+    try {
+      checkpoint.restore(model);
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+  }
 
-  app::train(iterationCount,
-             filteredMetrics,
-             goalState,
-             agent,
-             minMaxMetricTime.first,
-             minMaxMetricTime.second);
+  trainOptions.checkpointFile = checkpointFile;
+  trainOptions.checkpointFileInterval = checkpointInterval;
+  trainOptions.resume = resume ? &checkpoint : nullptr;
+  if (configJSON.count("earlyStopping")) {
+    json earlyStoppingJSON = configJSON["earlyStopping"];
+    trainOptions.earlyStopping.patterns = &trainedPatterns;
+    trainOptions.earlyStopping.checkpointInterval = earlyStoppingJSON.value("checkpointInterval", 100);
+    trainOptions.earlyStopping.topK = earlyStoppingJSON.value("topK", 100);
+    trainOptions.earlyStopping.threshold = earlyStoppingJSON.value("threshold", 0.95);
+    trainOptions.earlyStopping.patience = earlyStoppingJSON.value("patience", 3);
+  }
+  if (configJSON.count("successiveHalving")) {
+    json halvingJSON = configJSON["successiveHalving"];
+    trainOptions.successiveHalving.rounds = halvingJSON.value("rounds", 4);
+    trainOptions.successiveHalving.keepFraction = halvingJSON.value("keepFraction", 0.5);
+    trainOptions.successiveHalving.minMetrics = halvingJSON.value("minMetrics", 50);
+  }
+  std::cout << "Training with " << threadCount << " thread(s)." << std::endl;
+  try {
+    if (configJSON.count("convergenceReport") && !resume) {  // It resets the model.
+      json reportJSON = configJSON["convergenceReport"];
+      app::writeConvergenceReport(reportJSON["file"],
+                                  iterationCount,
+                                  trainedMetrics,
+                                  goalState,
+                                  trainedPatterns,
+                                  model,
+                                  minMaxMetricTime.first,
+                                  minMaxMetricTime.second,
+                                  reportJSON.value("checkpoints", 20),
+                                  reportJSON.value("topK", 100),
+                                  trainOptions);
+    }
 
-  /*auto rewardMultimap = qLearning.getStateActionPairContainer().getReverseMap();*/
+    if (configJSON.count("quantizationReport") && !resume) {  // It resets the model.
+      json reportJSON = configJSON["quantizationReport"];
+      QModel referenceModel(*tileCode, stepSize, discountRate, initialReward);
+      app::writeQuantizationReport(reportJSON["file"],
+                                   iterationCount,
+                                   trainedMetrics,
+                                   goalState,
+                                   trainedPatterns,
+                                   referenceModel,
+                                   model,
+                                   minMaxMetricTime.first,
+                                   minMaxMetricTime.second,
+                                   reportJSON.value("topK", 100),
+                                   trainOptions);
+    }
 
-  // Get the reward for each metrics.
-  std::multimap<rl::FLOAT, rl::StateAction<STATE, ACTION>> rewardMap;
-  for (auto p : patterns) {
-    auto reward =  qLearning.getStateActionValue(rl::StateAction<rl::floatVector, rl::floatVector>(
-        p->getGradientDescentParameters(), app::goalAction));
-    rewardMap.insert(std::pair<rl::FLOAT, rl::StateAction<STATE, ACTION>>(
-        reward, rl::StateAction<STATE, ACTION>(p, goalState)
-    ));
+    printTrainSummary(app::train(iterationCount,
+                                 trainedMetrics,
+                                 goalState,
+                                 model,
+                                 minMaxMetricTime.first,
+                                 minMaxMetricTime.second,
+                                 trainOptions));
+    std::cout << "Weights use " << model.getMemorySize() / (1024.0 * 1024.0) << "MB." << std::endl;
+  } catch(const char* e) {
+    std::cerr << e << std::endl;
+    exit(1);
+  } catch(exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+
+  rewards = app::score(patterns, model, &scheduler);
+
+  auto workerStats = scheduler.getStats();
+  for (size_t w = 0; w < workerStats.size(); w++) {
+    std::cout << "Worker " << w << ": busy " << workerStats[w].busySeconds << "s, idle "
+              << workerStats[w].idleSeconds << "s, " << workerStats[w].taskCount << " tasks ("
+              << workerStats[w].stolenCount << " stolen)" << std::endl;
+  }
+
+  if (configJSON.count("modelFile")) {
+    try {
+      ModelStore::write(configJSON["modelFile"], model, filteredMetrics);
+      std::cout << "Saved the model to " << configJSON["modelFile"].get<string>() << "." << std::endl;
+    } catch(exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
   }
 
-  app::serializeResult(resultFile, rewardMap);
+  app::serializeResult(resultFile, patterns, rewards, goalState);
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocation-counter.h"
+
+#if defined(COUNT_ALLOCATIONS)
+
+namespace {
+std::atomic<size_t> allocationCount(0);
+}  // namespace
+
+// The array and nothrow forms call these.
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void* memory = std::malloc(size > 0 ? size : 1);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+#endif
+
+namespace app {
+
+size_t getAllocationCount() {
+#if defined(COUNT_ALLOCATIONS)
+  return allocationCount.load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+
+}  // namespace app
@@ -2,74 +2,899 @@
 // Created by jandres on 11/11/16.
 //
 
-#include <random>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 
 #include <rl>
 
+#include "allocation-counter.h"
 #include "app.h"
 #include "declares.h"
+#include "interpolation.h"
 #include "plot-pattern.h"
 #include "metric.h"
+#include "metric-grid.h"
+#include "metric-store.h"
+#include "model-store.h"
+#include "pattern-distance.h"
+#include "q-model.h"
+#include "ranking.h"
+#include "task-scheduler.h"
+#include "train-checkpoint.h"
+#include "window-sampler.h"
 #include "../lib/json.hpp"
 
 using json = nlohmann::json;
 
 namespace app {
 
-void train(size_t iterationCount,
-           const vector<std::shared_ptr<Metric>> &metrics,
-           shared_ptr<STATE> &goalState,
-           rl::AgentSupervised<rl::floatVector, rl::floatVector> &agent,
-           size_t minMetricTime,
-           size_t maxMetricTime) {
+namespace {
 
+/**
+ * A sampled time window, and the reward of every metric's pattern in it.
+ */
+struct Window {
+  size_t iteration;
+  app::time timeBegin;
+  app::time timeEnd;
+  rl::FLOAT reward;
+};
+
+/**
+ * Samples the training windows. The window of iteration i only depends on
+ * (sampler, seed, i). Windows the goal metric can't be extracted from are
+ * skipped, so there can be fewer than iterationCount. Every window's goal
+ * pattern extraction is added to goalPatternCounts.
+ */
+template <class INTERPOLATION>
+vector<Window> sampleWindows(size_t iterationCount,
+                             const shared_ptr<STATE> &goalState,
+                             size_t minMetricTime,
+                             size_t maxMetricTime,
+                             const TrainOptions &options,
+                             app::PatternStatusCounts &goalPatternCounts) {
   size_t goalPatternTimeBegin = goalState->getTimeBegin();
   size_t goalPatternTimeEnd = goalState->getTimeEnd();
   size_t goalPatternTimeDuration = goalPatternTimeEnd - goalPatternTimeBegin;
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dis(
-      minMetricTime,
-      maxMetricTime - goalPatternTimeDuration);
+  WindowSampler sampler(options.sampler,
+                        options.seed,
+                        iterationCount,
+                        minMetricTime,
+                        maxMetricTime - goalPatternTimeDuration);
+  const MetricGrid *grid = options.grid;
+
+  auto goalMetric = goalState->getMetric();
+  size_t goalRow = grid != nullptr ? grid->findRow(goalMetric) : 0;
 
+  vector<Window> windows;
+  windows.reserve(iterationCount);
+  const STATE::FEATURES &goalFeatures = goalState->getFeatures();
+  STATE::FEATURES currentGoalFeatures;
   for (size_t i = 0; i < iterationCount; i++) {
-    app::time patternTimeBegin = dis(gen);
+    app::time patternTimeBegin = sampler.getTimeBegin(i);
     app::time patternTimeEnd = patternTimeBegin + goalPatternTimeDuration;
 
-    auto goalMetric = goalState->getMetric();
-
-    rl::spState<STATE> currentGoalPattern;
-    try {
-      currentGoalPattern = Metric::getPattern<app::PATTERN_SIZE>(
-          goalMetric,
-          patternTimeBegin,
-          patternTimeEnd);
-    } catch(...) {
+    auto status = grid != nullptr ?
+        grid->tryGetFeatures<app::PATTERN_SIZE>(goalRow, patternTimeBegin, patternTimeEnd, currentGoalFeatures) :
+        Metric::tryGetFeatures<app::PATTERN_SIZE, INTERPOLATION>(
+            *goalMetric, patternTimeBegin, patternTimeEnd, currentGoalFeatures);
+    goalPatternCounts.add(status);
+    if (status != app::PatternStatus::OK) {
       // Don't iterate if the goal metric don't have a metric for this time frame.
       continue;
     }
 
-    for (auto metric : metrics) {
-      auto currentPattern = Metric::getPattern<app::PATTERN_SIZE>(
-          metric,
-          patternTimeBegin,
-          patternTimeEnd);
+    // The reward only depends on the goal metric, so it is the same for every metric.
+    windows.push_back({i, patternTimeBegin, patternTimeEnd, -goalFeatures.getAbsoluteArea(currentGoalFeatures)});
+  }
+
+  return windows;
+}
+
+/**
+ * @return The end of the time frame goalState was extracted from. Its last value
+ *         is sampled one increment before it, see Metric::setPattern.
+ */
+app::time getGoalTimeEnd(const STATE &goalState) {
+  double increment = goalState.getDuration() / (app::PATTERN_SIZE - 1);
+  return static_cast<app::time>(std::llround(goalState.getTimeBegin() + increment * app::PATTERN_SIZE));
+}
+
+/**
+ * Features of each metric's pattern over the goal pattern's time frame, the
+ * pattern its ranking is scored on. Metrics without such a pattern get no features.
+ */
+template <class INTERPOLATION>
+vector<rl::FEATURE_VECTOR> getGoalTimeFeatures(const vector<std::shared_ptr<Metric>> &metrics,
+                                               const shared_ptr<STATE> &goalState,
+                                               const QModel &model,
+                                               const TrainOptions &options) {
+  vector<rl::FEATURE_VECTOR> goalTimeFeatures(metrics.size());
+  app::time timeBegin = static_cast<app::time>(goalState->getTimeBegin());
+  app::time timeEnd = getGoalTimeEnd(*goalState);
+  STATE pattern;
+  for (size_t m = 0; m < metrics.size(); m++) {
+    auto status = options.grid != nullptr ?
+        options.grid->tryGetPattern<app::PATTERN_SIZE>(m, timeBegin, timeEnd, pattern) :
+        Metric::tryGetPattern<app::PATTERN_SIZE, INTERPOLATION>(metrics[m], timeBegin, timeEnd, pattern);
+    if (status == app::PatternStatus::OK) {
+      goalTimeFeatures[m] = model.getFeatureVector(*pattern.getGradientDescentParameters(), *app::goalAction);
+    }
+    // Otherwise ranked last.
+  }
+  return goalTimeFeatures;
+}
+
+template <class INTERPOLATION>
+void trainWith(size_t iterationCount,
+               const vector<std::shared_ptr<Metric>> &metrics,
+               shared_ptr<STATE> &goalState,
+               QModel &model,
+               size_t minMetricTime,
+               size_t maxMetricTime,
+               const TrainOptions &options,
+               TrainSummary &summary) {
+  auto windows = sampleWindows<INTERPOLATION>(
+      iterationCount, goalState, minMetricTime, maxMetricTime, options, summary.goalPatterns);
+  auto goalFeatures = model.getFeatureVector(*goalState->getGradientDescentParameters(), *app::goalAction);
+  const MetricGrid *grid = options.grid;
+  TaskScheduler *scheduler = options.scheduler;
+
+  // Each window's updates are made in two phases, so the model does not depend on
+  // the number of threads or their timing:
+  //   1. Every metric's increment is computed from the weights as of the window's start.
+  //   2. Every weight range is owned by one task, adding its increments in metric order.
+  // Both only cover the metrics still trained, active[a] having features[a * tilingCount].
+  // Metrics without a pattern in the window are skipped, their status kept in statuses[a].
+  size_t tilingCount = model.getNumTilings();
+  vector<size_t> active(metrics.size());
+  for (size_t m = 0; m < active.size(); m++) {
+    active[m] = m;
+  }
+  vector<size_t> features(metrics.size() * tilingCount);
+  vector<rl::FLOAT> increments(metrics.size());
+  vector<app::PatternStatus> statuses(metrics.size());
+  size_t weightRangeCount = scheduler != nullptr ? scheduler->getWorkerCount() : 1;
+
+  // Between the phases, the features are counting sorted by the weight range that
+  // owns them, so each range's task only visits its own: range r adds the features
+  // rangeFeatures[rangeBegins[r], rangeBegins[r + 1]), indices into features in
+  // metric order. Range r owns the weights [size * r / weightRangeCount, size * (r + 1) / weightRangeCount).
+  vector<size_t> rangeBegins(weightRangeCount + 1);
+  vector<size_t> rangeEnds(weightRangeCount);
+  vector<size_t> rangeFeatures(metrics.size() * tilingCount);
+  auto getWeightRange = [&model, weightRangeCount](size_t weight) {
+    size_t range = weight * weightRangeCount / model.getSize();
+    bool isNext = range + 1 < weightRangeCount && model.getSize() * (range + 1) / weightRangeCount <= weight;
+    return isNext ? range + 1 : range;
+  };
+  auto bucketFeatures = [&]() {
+    std::fill(rangeBegins.begin(), rangeBegins.end(), 0);
+    for (size_t f = 0; f < active.size() * tilingCount; f++) {
+      if (statuses[f / tilingCount] == app::PatternStatus::OK) {
+        rangeBegins[getWeightRange(features[f]) + 1]++;
+      }
+    }
+    std::partial_sum(rangeBegins.begin(), rangeBegins.end(), rangeBegins.begin());
+    std::copy(rangeBegins.begin(), rangeBegins.end() - 1, rangeEnds.begin());
+    for (size_t f = 0; f < active.size() * tilingCount; f++) {
+      if (statuses[f / tilingCount] == app::PatternStatus::OK) {
+        rangeFeatures[rangeEnds[getWeightRange(features[f])]++] = f;
+      }
+    }
+  };
+
+  auto parallelFor = [scheduler](size_t count, size_t grainSize, const TaskScheduler::RANGE_TASK &task) {
+    if (scheduler != nullptr) {
+      scheduler->parallelFor(count, grainSize, task);
+    } else {
+      task(0, count);
+    }
+  };
+
+  // Successive halving: the iterations are split in rounds, and after each round
+  // but the last only the best valued fraction of the metrics is trained further.
+  const SuccessiveHalving &halving = options.successiveHalving;
+  size_t roundCount = std::max<size_t>(1, halving.rounds);
+  size_t round = 0;
+  size_t firstIteration = 0;
+  if (options.resume != nullptr) {
+    if (options.resume->metricCount != metrics.size() || options.resume->iterationCount != iterationCount) {
+      throw std::runtime_error("The checkpoint was written for other metrics or another iteration count.");
+    }
+    active = options.resume->activeMetrics;
+    round = options.resume->round;
+    firstIteration = options.resume->iterationsDone;
+  }
+  vector<rl::FEATURE_VECTOR> goalTimeFeatures;
+  if (roundCount > 1) {
+    goalTimeFeatures = getGoalTimeFeatures<INTERPOLATION>(metrics, goalState, model, options);
+  }
+  auto prune = [&]() {
+    vector<rl::FLOAT> values(active.size());
+    for (size_t a = 0; a < active.size(); a++) {
+      auto &f = goalTimeFeatures[active[a]];
+      values[a] = f.empty() ? -std::numeric_limits<rl::FLOAT>::infinity() : model.getValue(f);
+    }
+
+    size_t keepCount = static_cast<size_t>(std::ceil(active.size() * halving.keepFraction));
+    keepCount = std::min(active.size(), std::max(keepCount, halving.minMetrics));
+    auto kept = Ranking::getTop(values, keepCount);
+    std::sort(kept.begin(), kept.end());  // Keeps the metric order, see phase 2.
+    for (size_t k = 0; k < kept.size(); k++) {
+      kept[k] = active[kept[k]];
+    }
+    active.swap(kept);
+    std::cout << "Successive halving: training " << active.size() << " metrics." << std::endl;
+  };
+
+  // Calls options.checkpoint once an interval was completed since the last call, and
+  // when training is done. Returns false if training should stop.
+  size_t checkpointInterval = options.checkpoint ? options.checkpointInterval : 0;
+  size_t lastCheckpoint = firstIteration;
+  auto checkpoint = [&](size_t iterationsDone) {
+    if (checkpointInterval == 0 || iterationsDone == lastCheckpoint) {
+      return true;
+    }
+    bool due = iterationsDone / checkpointInterval > lastCheckpoint / checkpointInterval ||
+        iterationsDone == iterationCount;
+    if (!due) {
+      return true;
+    }
+    lastCheckpoint = iterationsDone;
+    return options.checkpoint(iterationsDone);
+  };
+
+  // Writes a TrainCheckpoint once a file interval was completed since the last one,
+  // and when training ends.
+  std::unique_ptr<CheckpointWriter> checkpointWriter;
+  size_t fileInterval = std::max<size_t>(1, options.checkpointFileInterval);
+  size_t lastFileCheckpoint = firstIteration;
+  if (!options.checkpointFile.empty()) {
+    checkpointWriter.reset(new CheckpointWriter(options.checkpointFile));
+  }
+  auto writeCheckpoint = [&](size_t iterationsDone, bool isLast) {
+    if (!checkpointWriter ||
+        (!isLast && iterationsDone / fileInterval == lastFileCheckpoint / fileInterval)) {
+      return;
+    }
+    lastFileCheckpoint = iterationsDone;
+
+    TrainCheckpoint trainCheckpoint;
+    trainCheckpoint.seed = options.seed;
+    trainCheckpoint.sampler = options.sampler;
+    trainCheckpoint.iterationCount = iterationCount;
+    trainCheckpoint.iterationsDone = iterationsDone;
+    trainCheckpoint.round = round;
+    trainCheckpoint.metricCount = metrics.size();
+    trainCheckpoint.activeMetrics = active;
+    trainCheckpoint.capture(model);
+    checkpointWriter->write(std::move(trainCheckpoint));
+    if (isLast) {
+      checkpointWriter->wait();
+    }
+  };
+  auto finish = [&](size_t iterationsDone) {
+    writeCheckpoint(iterationsDone, true);
+    summary.iterations = iterationsDone;
+    summary.activeMetrics = active;
+  };
+
+  // The window's tasks. Made once, they are run on the current window without
+  // allocating: patterns' normalized y values are extracted into a buffer on the
+  // task's stack, and their tiles straight into features.
+  const Window *currentWindow = nullptr;
+  rl::FLOAT goalValue = 0;
+  TaskScheduler::RANGE_TASK computeIncrements = [&](size_t activeBegin, size_t activeEnd) {
+    const Window &window = *currentWindow;
+    STATE::FEATURES patternFeatures;
+    for (size_t a = activeBegin; a < activeEnd; a++) {
+      size_t m = active[a];
+      statuses[a] = grid != nullptr ?
+          grid->tryGetFeatures<app::PATTERN_SIZE>(m, window.timeBegin, window.timeEnd, patternFeatures) :
+          Metric::tryGetFeatures<app::PATTERN_SIZE, INTERPOLATION>(
+              *metrics[m], window.timeBegin, window.timeEnd, patternFeatures);
+      if (statuses[a] != app::PatternStatus::OK) {
+        continue;
+      }
+
+      size_t* currentFeatures = features.data() + a * tilingCount;
+      model.getFeatures(patternFeatures, metrics[m]->getMetricIndex(), currentFeatures);
+      increments[a] = model.getIncrement(currentFeatures, window.reward, goalValue);
+    }
+  };
+  TaskScheduler::RANGE_TASK addIncrements = [&](size_t rangeBegin, size_t rangeEnd) {
+    for (size_t b = rangeBegins[rangeBegin]; b < rangeBegins[rangeEnd]; b++) {
+      size_t f = rangeFeatures[b];
+      model.addIncrement(features[f], increments[f / tilingCount]);
+    }
+  };
+
+  bool isFirstWindow = true;
+  for (size_t i = 0; i < windows.size(); i++) {
+    const Window &window = windows[i];
+    if (window.iteration < firstIteration) {
+      continue;
+    }
+
+    // Counts the iterations skipped since the last window.
+    if (!checkpoint(window.iteration)) {
+      finish(window.iteration);
+      return;
+    }
+
+    while (round + 1 < roundCount && window.iteration >= iterationCount * (round + 1) / roundCount) {
+      prune();
+      round++;
+    }
 
-      agent.train(
-          currentPattern->getGradientDescentParameters(),
-          app::goalAction,
-          -goalState->getAbsoluteArea(*currentGoalPattern),  // Reward.
-          goalState->getGradientDescentParameters());
+    size_t allocationCount = getAllocationCount();
+    currentWindow = &window;
+    goalValue = model.getValue(goalFeatures);
+    parallelFor(active.size(), scheduler != nullptr ? scheduler->getGrainSize(active.size()) : 1, computeIncrements);
+    for (size_t a = 0; a < active.size(); a++) {
+      summary.patterns.add(statuses[a]);
+      summary.updateCount += statuses[a] == app::PatternStatus::OK ? 1 : 0;
     }
 
+    bucketFeatures();
+    model.reserveIncrements(rangeBegins.back());
+    parallelFor(weightRangeCount, 1, addIncrements);
+
     std::cout << "Traning: "
-              << (static_cast<float>(i) / static_cast<float>(iterationCount)) * 100.0f
+              << (static_cast<float>(i) / static_cast<float>(windows.size())) * 100.0f
               << "%"
               << std::endl;
+    if (!isFirstWindow) {
+      summary.steadyStateAllocations += getAllocationCount() - allocationCount;
+    }
+    isFirstWindow = false;
+
+    size_t iterationsDone = i + 1 < windows.size() ? window.iteration + 1 : iterationCount;
+    writeCheckpoint(iterationsDone, false);
+    if (!checkpoint(iterationsDone)) {
+      finish(iterationsDone);
+      return;
+    }
+  }
+  checkpoint(iterationCount);
+  finish(iterationCount);
+}
+
+template <class INTERPOLATION>
+void trainAgentWith(size_t iterationCount,
+                    const vector<std::shared_ptr<Metric>> &metrics,
+                    shared_ptr<STATE> &goalState,
+                    rl::AgentSupervised<rl::floatVector, rl::floatVector> &agent,
+                    size_t minMetricTime,
+                    size_t maxMetricTime,
+                    const TrainOptions &options,
+                    TrainSummary &summary) {
+  auto windows = sampleWindows<INTERPOLATION>(
+      iterationCount, goalState, minMetricTime, maxMetricTime, options, summary.goalPatterns);
+  const MetricGrid *grid = options.grid;
+  auto goalParameters = goalState->getGradientDescentParameters();
+
+  STATE pattern;
+  bool isFirstWindow = true;
+  for (size_t i = 0; i < windows.size(); i++) {
+    const Window &window = windows[i];
+    size_t allocationCount = getAllocationCount();
+    for (size_t m = 0; m < metrics.size(); m++) {
+      auto status = grid != nullptr ?
+          grid->tryGetPattern<app::PATTERN_SIZE>(m, window.timeBegin, window.timeEnd, pattern) :
+          Metric::tryGetPattern<app::PATTERN_SIZE, INTERPOLATION>(
+              metrics[m], window.timeBegin, window.timeEnd, pattern);
+      summary.patterns.add(status);
+      if (status != app::PatternStatus::OK) {
+        continue;
+      }
+
+      agent.train(pattern.getGradientDescentParameters(), app::goalAction, window.reward, goalParameters);
+      summary.updateCount++;
+    }
+
+    std::cout << "Traning: "
+              << (static_cast<float>(i) / static_cast<float>(windows.size())) * 100.0f
+              << "%"
+              << std::endl;
+    if (!isFirstWindow) {
+      summary.steadyStateAllocations += getAllocationCount() - allocationCount;
+    }
+    isFirstWindow = false;
+  }
+  summary.iterations = iterationCount;
+  summary.activeMetrics.resize(metrics.size());
+  std::iota(summary.activeMetrics.begin(), summary.activeMetrics.end(), 0);
+}
+
+template <class INTERPOLATION>
+vector<size_t> screenWith(const vector<std::shared_ptr<Metric>> &metrics,
+                          const shared_ptr<STATE> &goalState,
+                          size_t minMetricTime,
+                          size_t maxMetricTime,
+                          const ScreenOptions &screenOptions,
+                          const TrainOptions &options) {
+  const MetricGrid *grid = options.grid;
+  TaskScheduler *scheduler = options.scheduler;
+  size_t goalPatternTimeDuration = goalState->getTimeEnd() - goalState->getTimeBegin();
+  WindowSampler sampler(options.sampler,
+                        options.seed,
+                        screenOptions.windowCount,
+                        minMetricTime,
+                        maxMetricTime - goalPatternTimeDuration);
+
+  auto goalMetric = goalState->getMetric();
+  size_t goalIndex = std::find(metrics.begin(), metrics.end(), goalMetric) - metrics.begin();
+  size_t goalRow = grid != nullptr ? grid->findRow(goalMetric) : 0;
+
+  // Sum of each metric's areas, over the windows it has a pattern in.
+  vector<double> areaSums(metrics.size(), 0);
+  vector<size_t> windowCounts(metrics.size(), 0);
+  for (size_t i = 0; i < screenOptions.windowCount; i++) {
+    app::time timeBegin = sampler.getTimeBegin(i);
+    app::time timeEnd = timeBegin + goalPatternTimeDuration;
+
+    STATE::FEATURES goalFeatures;
+    auto goalStatus = grid != nullptr ?
+        grid->tryGetFeatures<app::PATTERN_SIZE>(goalRow, timeBegin, timeEnd, goalFeatures) :
+        Metric::tryGetFeatures<app::PATTERN_SIZE, INTERPOLATION>(*goalMetric, timeBegin, timeEnd, goalFeatures);
+    if (goalStatus != app::PatternStatus::OK) {
+      continue;
+    }
+
+    auto compareRange = [&](size_t metricBegin, size_t metricEnd) {
+      // The range's patterns back to back, then compared in one pass.
+      vector<float> candidates((metricEnd - metricBegin) * STATE::PADDED_SIZE);
+      vector<size_t> candidateMetrics;
+      candidateMetrics.reserve(metricEnd - metricBegin);
+      STATE::FEATURES features;
+      for (size_t m = metricBegin; m < metricEnd; m++) {
+        auto status = grid != nullptr ?
+            grid->tryGetFeatures<app::PATTERN_SIZE>(m, timeBegin, timeEnd, features) :
+            Metric::tryGetFeatures<app::PATTERN_SIZE, INTERPOLATION>(*metrics[m], timeBegin, timeEnd, features);
+        if (status != app::PatternStatus::OK) {
+          continue;  // No pattern in this window.
+        }
+        std::copy(features.y, features.y + STATE::PADDED_SIZE,
+                  candidates.data() + candidateMetrics.size() * STATE::PADDED_SIZE);
+        candidateMetrics.push_back(m);
+      }
+
+      vector<float> areas(candidateMetrics.size());
+      PatternDistance::absoluteArea(goalFeatures.y,
+                                    candidates.data(),
+                                    candidateMetrics.size(),
+                                    app::PATTERN_SIZE,
+                                    areas.data());
+      for (size_t c = 0; c < candidateMetrics.size(); c++) {
+        areaSums[candidateMetrics[c]] += areas[c];
+        windowCounts[candidateMetrics[c]]++;
+      }
+    };
+    if (scheduler != nullptr) {
+      scheduler->parallelFor(metrics.size(), scheduler->getGrainSize(metrics.size()), compareRange);
+    } else {
+      compareRange(0, metrics.size());
+    }
+  }
+
+  // Closest first, metrics without any pattern last.
+  vector<rl::FLOAT> closeness(metrics.size());
+  for (size_t m = 0; m < metrics.size(); m++) {
+    closeness[m] = windowCounts[m] == 0 ?
+        -std::numeric_limits<rl::FLOAT>::infinity() :
+        static_cast<rl::FLOAT>(-areaSums[m] / windowCounts[m]);
+  }
+
+  size_t topK = screenOptions.topK > 0 ? screenOptions.topK : metrics.size();
+  vector<size_t> kept;
+  for (auto m : Ranking::getTop(closeness, topK)) {
+    if (screenOptions.maxArea < 0 || -closeness[m] <= screenOptions.maxArea) {
+      kept.push_back(m);
+    }
+  }
+  if (goalIndex < metrics.size() && std::find(kept.begin(), kept.end(), goalIndex) == kept.end()) {
+    kept.push_back(goalIndex);
+  }
+  std::sort(kept.begin(), kept.end());
+  return kept;
+}
+
+}  // namespace
+
+vector<size_t> screenMetrics(const vector<std::shared_ptr<Metric>> &metrics,
+                             const shared_ptr<STATE> &goalState,
+                             size_t minMetricTime,
+                             size_t maxMetricTime,
+                             const ScreenOptions &screenOptions,
+                             const TrainOptions &options) {
+  switch (options.interpolation) {
+    case Interpolation::LINEAR:
+      return screenWith<LinearInterpolation>(
+          metrics, goalState, minMetricTime, maxMetricTime, screenOptions, options);
+    case Interpolation::CATMULL_ROM:
+      return screenWith<CatmullRomInterpolation>(
+          metrics, goalState, minMetricTime, maxMetricTime, screenOptions, options);
+    case Interpolation::SPLINE:
+      return screenWith<SplineInterpolation>(
+          metrics, goalState, minMetricTime, maxMetricTime, screenOptions, options);
+    case Interpolation::METRIC_SPLINE:
+    default:
+      return screenWith<MetricSplineInterpolation>(
+          metrics, goalState, minMetricTime, maxMetricTime, screenOptions, options);
+  }
+}
+
+Learner parseLearner(const std::string &name) {
+  if (name == "qLearningGD") {
+    return Learner::Q_LEARNING_GD;
+  } else if (name == "td0") {
+    return Learner::TD0;
+  }
+
+  throw std::domain_error("Unknown learner \"" + name + "\".");
+}
+
+TrainSummary train(size_t iterationCount,
+                   const vector<std::shared_ptr<Metric>> &metrics,
+                   shared_ptr<STATE> &goalState,
+                   QModel &model,
+                   size_t minMetricTime,
+                   size_t maxMetricTime,
+                   const TrainOptions &options) {
+  TrainOptions trainOptions = options;
+  const EarlyStopping &earlyStopping = options.earlyStopping;
+  vector<rl::FLOAT> previousValues;
+  size_t stableCount = 0;
+  if (earlyStopping.patterns != nullptr) {
+    previousValues = score(*earlyStopping.patterns, model, options.scheduler);
+    trainOptions.checkpointInterval = std::max<size_t>(1, earlyStopping.checkpointInterval);
+    trainOptions.checkpoint = [&](size_t iterationsDone) {
+      if (options.checkpoint && !options.checkpoint(iterationsDone)) {
+        return false;
+      }
+
+      vector<rl::FLOAT> values = score(*earlyStopping.patterns, model, options.scheduler);
+      double tau = Ranking::getKendallTau(values, previousValues, earlyStopping.topK);
+      stableCount = tau >= earlyStopping.threshold ? stableCount + 1 : 0;
+      previousValues.swap(values);
+
+      std::cout << "Checkpoint at " << iterationsDone << " iterations: Kendall tau " << tau << std::endl;
+      return stableCount < earlyStopping.patience;
+    };
+  }
+
+  TrainSummary summary;
+  auto start = std::chrono::steady_clock::now();
+  switch (options.interpolation) {
+    case Interpolation::LINEAR:
+      trainWith<LinearInterpolation>(
+          iterationCount, metrics, goalState, model, minMetricTime, maxMetricTime, trainOptions, summary);
+      break;
+    case Interpolation::CATMULL_ROM:
+      trainWith<CatmullRomInterpolation>(
+          iterationCount, metrics, goalState, model, minMetricTime, maxMetricTime, trainOptions, summary);
+      break;
+    case Interpolation::SPLINE:
+      trainWith<SplineInterpolation>(
+          iterationCount, metrics, goalState, model, minMetricTime, maxMetricTime, trainOptions, summary);
+      break;
+    case Interpolation::METRIC_SPLINE:
+    default:
+      trainWith<MetricSplineInterpolation>(
+          iterationCount, metrics, goalState, model, minMetricTime, maxMetricTime, trainOptions, summary);
+      break;
+  }
+  summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  summary.stoppedEarly = summary.iterations < iterationCount;
+  return summary;
+}
+
+TrainSummary train(size_t iterationCount,
+                   const vector<std::shared_ptr<Metric>> &metrics,
+                   shared_ptr<STATE> &goalState,
+                   rl::AgentSupervised<rl::floatVector, rl::floatVector> &agent,
+                   size_t minMetricTime,
+                   size_t maxMetricTime,
+                   const TrainOptions &options) {
+  if (options.checkpoint || options.earlyStopping.patterns != nullptr || options.successiveHalving.rounds > 1 ||
+      !options.checkpointFile.empty() || options.resume != nullptr) {
+    throw std::invalid_argument(
+        "Checkpoints, early stopping, successive halving and resuming need the td0 learner (a QModel).");
+  }
+
+  TrainSummary summary;
+  auto start = std::chrono::steady_clock::now();
+  switch (options.interpolation) {
+    case Interpolation::LINEAR:
+      trainAgentWith<LinearInterpolation>(
+          iterationCount, metrics, goalState, agent, minMetricTime, maxMetricTime, options, summary);
+      break;
+    case Interpolation::CATMULL_ROM:
+      trainAgentWith<CatmullRomInterpolation>(
+          iterationCount, metrics, goalState, agent, minMetricTime, maxMetricTime, options, summary);
+      break;
+    case Interpolation::SPLINE:
+      trainAgentWith<SplineInterpolation>(
+          iterationCount, metrics, goalState, agent, minMetricTime, maxMetricTime, options, summary);
+      break;
+    case Interpolation::METRIC_SPLINE:
+    default:
+      trainAgentWith<MetricSplineInterpolation>(
+          iterationCount, metrics, goalState, agent, minMetricTime, maxMetricTime, options, summary);
+      break;
+  }
+  summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return summary;
+}
+
+namespace {
+
+template <class MODEL>
+vector<rl::FLOAT> scoreWith(const vector<rl::spState<STATE>> &patterns,
+                            const MODEL &model,
+                            TaskScheduler *scheduler) {
+  vector<rl::FLOAT> values(patterns.size());
+  auto scoreRange = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      values[i] = model.getValue(*patterns[i]->getGradientDescentParameters(), *app::goalAction);
+    }
+  };
+
+  if (scheduler != nullptr) {
+    scheduler->parallelFor(patterns.size(), scheduler->getGrainSize(patterns.size()), scoreRange);
+  } else {
+    scoreRange(0, patterns.size());
+  }
+  return values;
+}
+
+}  // namespace
+
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        const QModel &model,
+                        TaskScheduler *scheduler) {
+  return scoreWith(patterns, model, scheduler);
+}
+
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        const ModelStore &model,
+                        TaskScheduler *scheduler) {
+  return scoreWith(patterns, model, scheduler);
+}
+
+vector<rl::FLOAT> score(const vector<rl::spState<STATE>> &patterns,
+                        rl::algorithm::QLearningGD &qLearning) {
+  vector<rl::FLOAT> values(patterns.size());
+  for (size_t i = 0; i < patterns.size(); i++) {
+    values[i] = qLearning.getStateActionValue(rl::StateAction<rl::floatVector, rl::floatVector>(
+        patterns[i]->getGradientDescentParameters(), app::goalAction));
+  }
+  return values;
+}
+
+void scoreWithModel(const ModelStore &model,
+                    const vector<std::shared_ptr<Metric>> &metrics,
+                    const string &goalMetric,
+                    app::time timeBegin,
+                    app::time timeEnd,
+                    Interpolation interpolation,
+                    TaskScheduler *scheduler,
+                    const string &resultFile) {
+  // The metric index is a tile coded dimension, so each metric must keep the index it was trained with.
+  vector<std::shared_ptr<Metric>> trainedMetrics;
+  for (const auto &metric : metrics) {
+    size_t metricIndex;
+    if (model.findMetricIndex(metric->getMetricName(), metricIndex)) {
+      trainedMetrics.push_back(
+          std::shared_ptr<Metric>(new Metric(metric->getMetricName(), metric->getData(), metricIndex)));
+    }
+  }
+  std::cout << "Metrics the model wasn't trained with: " << metrics.size() - trainedMetrics.size() << std::endl;
+
+  auto patterns = Metric::getPatternsFromMetrics<app::PATTERN_SIZE>(
+      trainedMetrics, timeBegin, timeEnd, interpolation, scheduler);
+  std::cout << "Valid metrics: " << patterns.size() << std::endl;
+
+  size_t goalPatternIndex = 0;
+  PlotPatternSpecialized::getPatternIndexFromMetricName(patterns, goalMetric, goalPatternIndex);
+  if (goalPatternIndex == patterns.size()) {
+    throw std::runtime_error("Goal Pattern was not found in the given metrics.");
+  }
+
+  serializeResult(resultFile, patterns, score(patterns, model, scheduler), patterns[goalPatternIndex]);
+}
+
+void writeConvergenceReport(const string &reportFile,
+                            size_t iterationCount,
+                            const vector<std::shared_ptr<Metric>> &metrics,
+                            rl::spState<STATE> &goalState,
+                            const vector<rl::spState<STATE>> &patterns,
+                            QModel &model,
+                            size_t minMetricTime,
+                            size_t maxMetricTime,
+                            size_t checkpointCount,
+                            size_t topK,
+                            const TrainOptions &options) {
+  const vector<Sampler> samplers = {Sampler::UNIFORM, Sampler::STRATIFIED, Sampler::SOBOL};
+  size_t goalPatternTimeDuration = goalState->getTimeEnd() - goalState->getTimeBegin();
+
+  // Scores at each checkpoint, per sampler.
+  vector<vector<std::pair<size_t, vector<rl::FLOAT>>>> checkpoints(samplers.size());
+  for (size_t s = 0; s < samplers.size(); s++) {
+    std::cout << "Convergence report: training with the " << getSamplerName(samplers[s]) << " sampler." << std::endl;
+
+    TrainOptions samplerOptions = options;
+    samplerOptions.sampler = samplers[s];
+    samplerOptions.earlyStopping.patterns = nullptr;
+    samplerOptions.checkpointFile.clear();
+    samplerOptions.resume = nullptr;
+    samplerOptions.checkpointInterval = std::max<size_t>(1, iterationCount / std::max<size_t>(1, checkpointCount));
+    samplerOptions.checkpoint = [&](size_t iterationsDone) {
+      checkpoints[s].emplace_back(iterationsDone, score(patterns, model, options.scheduler));
+      return true;
+    };
+
+    model.reset();
+    train(iterationCount, metrics, goalState, model, minMetricTime, maxMetricTime, samplerOptions);
+  }
+  model.reset();
+
+  vector<rl::FLOAT> consensus(patterns.size(), 0);
+  for (auto &samplerCheckpoints : checkpoints) {
+    if (samplerCheckpoints.empty()) {
+      continue;
+    }
+    auto &final = samplerCheckpoints.back().second;
+    for (size_t i = 0; i < consensus.size(); i++) {
+      consensus[i] += final[i] / samplers.size();
+    }
   }
+
+  json reportJSON = {{"iterationCount", iterationCount}, {"topK", topK}, {"samplers", json::array()}};
+  for (size_t s = 0; s < samplers.size(); s++) {
+    WindowSampler sampler(samplers[s],
+                          options.seed,
+                          iterationCount,
+                          minMetricTime,
+                          maxMetricTime - goalPatternTimeDuration);
+    vector<app::time> timeBegins;
+    json checkpointsJSON = json::array();
+    size_t iterationsDone = 0;
+    for (auto &checkpoint : checkpoints[s]) {
+      // Largest gap between the window starts so far, as a fraction of the range.
+      for (; iterationsDone < checkpoint.first; iterationsDone++) {
+        timeBegins.push_back(sampler.getTimeBegin(iterationsDone));
+      }
+      std::sort(timeBegins.begin(), timeBegins.end());
+      double range = static_cast<double>(maxMetricTime - goalPatternTimeDuration - minMetricTime + 1);
+      double largestGap = 0;
+      app::time previous = minMetricTime;
+      for (auto t : timeBegins) {
+        largestGap = std::max(largestGap, static_cast<double>(t - previous));
+        previous = t;
+      }
+      largestGap = std::max(largestGap, static_cast<double>(maxMetricTime - goalPatternTimeDuration - previous));
+
+      auto &final = checkpoints[s].back().second;
+      checkpointsJSON.push_back({
+          {"iterations", checkpoint.first},
+          {"largestGap", largestGap / range},
+          {"kendallTauFinal", Ranking::getKendallTau(final, checkpoint.second, topK)},
+          {"kendallTauConsensus", Ranking::getKendallTau(consensus, checkpoint.second, topK)},
+          {"topOverlapFinal", Ranking::getTopOverlap(final, checkpoint.second, topK)},
+          {"topOverlapConsensus", Ranking::getTopOverlap(consensus, checkpoint.second, topK)}
+      });
+    }
+    reportJSON["samplers"].push_back({{"sampler", getSamplerName(samplers[s])}, {"checkpoints", checkpointsJSON}});
+  }
+
+  ofstream reportFileStream(reportFile);
+  if (!reportFileStream.is_open()) {
+    throw std::runtime_error("Problem opening convergence report file.");
+  }
+  reportFileStream << reportJSON.dump(2);
+}
+
+void writeQuantizationReport(const string &reportFile,
+                             size_t iterationCount,
+                             const vector<std::shared_ptr<Metric>> &metrics,
+                             rl::spState<STATE> &goalState,
+                             const vector<rl::spState<STATE>> &patterns,
+                             QModel &referenceModel,
+                             QModel &quantizedModel,
+                             size_t minMetricTime,
+                             size_t maxMetricTime,
+                             size_t topK,
+                             const TrainOptions &options) {
+  TrainOptions reportOptions = options;
+  reportOptions.earlyStopping.patterns = nullptr;
+  reportOptions.checkpoint = nullptr;
+  reportOptions.checkpointFile.clear();
+  reportOptions.resume = nullptr;
+
+  auto getStorageName = [](QModel::Storage storage) {
+    switch (storage) {
+      case QModel::Storage::SPARSE:
+        return "sparse";
+      case QModel::Storage::HALF:
+        return "half";
+      default:
+        return "float";
+    }
+  };
+
+  vector<QModel*> models = {&referenceModel, &quantizedModel};
+  vector<vector<rl::FLOAT>> scores(models.size());
+  json modelsJSON = json::array();
+  for (size_t m = 0; m < models.size(); m++) {
+    std::cout << "Quantization report: training with " << getStorageName(models[m]->getStorage())
+              << " weights." << std::endl;
+    models[m]->reset();
+    auto summary = train(iterationCount, metrics, goalState, *models[m], minMetricTime, maxMetricTime, reportOptions);
+    scores[m] = score(patterns, *models[m], options.scheduler);
+    models[m]->reset();
+    modelsJSON.push_back({
+        {"weights", getStorageName(models[m]->getStorage())},
+        {"memoryBytes", models[m]->getMemorySize()},
+        {"seconds", summary.seconds}
+    });
+  }
+
+  double maxDifference = 0;
+  double meanDifference = 0;
+  for (size_t i = 0; i < patterns.size(); i++) {
+    double difference = std::abs(static_cast<double>(scores[1][i]) - scores[0][i]);
+    maxDifference = std::max(maxDifference, difference);
+    meanDifference += difference / patterns.size();
+  }
+
+  json reportJSON = {
+      {"iterationCount", iterationCount},
+      {"topK", topK},
+      {"models", modelsJSON},
+      {"kendallTau", Ranking::getKendallTau(scores[0], scores[1], topK)},
+      {"topOverlap", Ranking::getTopOverlap(scores[0], scores[1], topK)},
+      {"maxScoreDifference", maxDifference},
+      {"meanScoreDifference", meanDifference}
+  };
+
+  ofstream reportFileStream(reportFile);
+  if (!reportFileStream.is_open()) {
+    throw std::runtime_error("Problem opening quantization report file.");
+  }
+  reportFileStream << reportJSON.dump(2);
+}
+
+vector<std::shared_ptr<Metric>> loadMetrics(const string &metricsFile) {
+  if (MetricStore::isMetricStore(metricsFile)) {
+    return MetricStore::open(metricsFile)->getMetrics();
+  }
+
+  std::ifstream metricsFileStream(metricsFile);
+  if (!metricsFileStream.is_open()) {
+    throw std::runtime_error("Problem opening metric file. Probably does not exist.");
+  }
+  return Metric::parseMetrics(metricsFileStream);
+}
+
+void convertMetrics(const string &jsonFile, const string &storeFile) {
+  std::ifstream jsonFileStream(jsonFile);
+  if (!jsonFileStream.is_open()) {
+    throw std::runtime_error("Problem opening metric file. Probably does not exist.");
+  }
+
+  auto metrics = Metric::parseMetrics(jsonFileStream);
+  MetricStore::write(storeFile, metrics);
+  std::cout << "Converted " << metrics.size() << " metrics into " << storeFile << std::endl;
 }
 
 void serializeResult(const string &resultFile,
@@ -115,4 +940,17 @@ void serializeResult(const string &resultFile,
   resultFileStream.close();
 }
 
+void serializeResult(const string &resultFile,
+                     const vector<rl::spState<STATE>> &patterns,
+                     const vector<rl::FLOAT> &rewards,
+                     const rl::spState<STATE> &goalState) {
+  std::multimap<rl::FLOAT, rl::StateAction<STATE, ACTION>> rewardMap;
+  for (size_t i = 0; i < patterns.size(); i++) {
+    rewardMap.insert(std::pair<rl::FLOAT, rl::StateAction<STATE, ACTION>>(
+        rewards[i], rl::StateAction<STATE, ACTION>(patterns[i], goalState)
+    ));
+  }
+  serializeResult(resultFile, rewardMap);
+}
+
 }  // namespace APP
\ No newline at end of file
@@ -0,0 +1,119 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "cubic-spline.h"
+
+void CubicSpline::fit(const MetricData& data, size_t begin, size_t end, double* a, double* b, double* c) {
+  size_t n = end - begin;
+  std::fill(a, a + n, 0.0);
+  std::fill(b, b + n, 0.0);
+  std::fill(c, c + n, 0.0);
+  if (n < 2) {
+    return;
+  }
+
+  if (n > 2) {
+    // Tridiagonal system for b[1..n-2], b[0] = b[n-1] = 0 (zero curvature).
+    // a and c hold the forward sweep's modified upper diagonal and right hand
+    // side until the back substitution.
+    double* upper = a;
+    double* rhs = c;
+    double h0 = static_cast<double>(data.timeAt(begin + 1) - data.timeAt(begin));
+    double slope0 = (data.valueAt(begin + 1) - data.valueAt(begin)) / h0;
+    for (size_t i = 1; i < n - 1; i++) {
+      double h1 = static_cast<double>(data.timeAt(begin + i + 1) - data.timeAt(begin + i));
+      double slope1 = (data.valueAt(begin + i + 1) - data.valueAt(begin + i)) / h1;
+      double lower = h0 / 3.0;
+      double diagonal = 2.0 / 3.0 * (h0 + h1);
+
+      double m = diagonal - lower * upper[i - 1];
+      upper[i] = (h1 / 3.0) / m;
+      rhs[i] = (slope1 - slope0 - lower * rhs[i - 1]) / m;
+
+      h0 = h1;
+      slope0 = slope1;
+    }
+
+    for (size_t i = n - 2; i > 0; i--) {
+      b[i] = rhs[i] - upper[i] * b[i + 1];
+    }
+  }
+
+  for (size_t i = 0; i < n - 1; i++) {
+    double h = static_cast<double>(data.timeAt(begin + i + 1) - data.timeAt(begin + i));
+    a[i] = 1.0 / 3.0 * (b[i + 1] - b[i]) / h;
+    c[i] = (data.valueAt(begin + i + 1) - data.valueAt(begin + i)) / h - 1.0 / 3.0 * (2.0 * b[i] + b[i + 1]) * h;
+  }
+
+  // Right extrapolation, f'_{n-2}(t_{n-1}).
+  double h = static_cast<double>(data.timeAt(end - 1) - data.timeAt(end - 2));
+  a[n - 1] = 0.0;
+  c[n - 1] = 3.0 * a[n - 2] * h * h + 2.0 * b[n - 2] * h + c[n - 2];
+}
+
+void CubicSpline::evaluate(const MetricData& data,
+                           size_t begin,
+                           size_t end,
+                           const double* a,
+                           const double* b,
+                           const double* c,
+                           double timeBegin,
+                           double increment,
+                           size_t count,
+                           double* out) {
+  size_t n = end - begin;
+  if (n == 0) {
+    std::fill(out, out + count, 0.0);
+    return;
+  }
+  if (n == 1) {
+    std::fill(out, out + count, data.valueAt(begin));
+    return;
+  }
+
+  double timeFirst = static_cast<double>(data.timeAt(begin));
+  double timeLast = static_cast<double>(data.timeAt(end - 1));
+
+  size_t index = 0;
+  for (size_t k = 0; k < count; k++) {
+    double time = timeBegin + increment * k;
+    if (time >= timeFirst) {
+      size_t after = data.upperBoundFrom(static_cast<app::time>(time), begin + index + 1);
+      index = std::min(after - 1 - begin, n - 2);
+    }
+
+    if (time < timeFirst) {
+      out[k] = c[0] * (time - timeFirst) + data.valueAt(begin);
+    } else if (time > timeLast) {
+      out[k] = c[n - 1] * (time - timeLast) + data.valueAt(end - 1);
+    } else {
+      double h = time - static_cast<double>(data.timeAt(begin + index));
+      out[k] = ((a[index] * h + b[index]) * h + c[index]) * h + data.valueAt(begin + index);
+    }
+  }
+}
+
+void CubicSpline::interpolate(const MetricData& data,
+                              size_t begin,
+                              size_t end,
+                              double timeBegin,
+                              double increment,
+                              size_t count,
+                              double* out) {
+  static thread_local std::vector<double> scratch;
+
+  size_t n = end - begin;
+  if (scratch.size() < 3 * n) {
+    scratch.resize(3 * n);
+  }
+
+  double* a = scratch.data();
+  double* b = a + n;
+  double* c = b + n;
+  CubicSpline::fit(data, begin, end, a, b, c);
+  CubicSpline::evaluate(data, begin, end, a, b, c, timeBegin, increment, count, out);
+}
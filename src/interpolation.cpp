@@ -0,0 +1,163 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "cubic-spline.h"
+#include "interpolation.h"
+#include "metric.h"
+
+namespace app {
+
+Interpolation parseInterpolation(const std::string &name) {
+  if (name == "linear") {
+    return Interpolation::LINEAR;
+  } else if (name == "catmullRom") {
+    return Interpolation::CATMULL_ROM;
+  } else if (name == "spline") {
+    return Interpolation::SPLINE;
+  } else if (name == "metricSpline") {
+    return Interpolation::METRIC_SPLINE;
+  }
+
+  throw std::domain_error("Unknown interpolation \"" + name + "\".");
+}
+
+}  // namespace app
+
+namespace {
+
+/**
+ * Calls segment(k, index, time) for each of the count evenly spaced times, with
+ * index the datapoint (relative to begin) that starts the segment the time is
+ * in, clamped to the first/last segment. O(count * log(gap)) with gap the
+ * datapoints between samples. Requires end - begin >= 2.
+ */
+template <class SEGMENT>
+void forEachSegment(const MetricData &data,
+                    size_t begin,
+                    size_t end,
+                    double timeBegin,
+                    double increment,
+                    size_t count,
+                    SEGMENT segment) {
+  size_t n = end - begin;
+  double timeFirst = static_cast<double>(data.timeAt(begin));
+
+  size_t index = 0;
+  for (size_t k = 0; k < count; k++) {
+    double time = timeBegin + increment * k;
+    if (time >= timeFirst) {
+      // Gallop, the samples can be many datapoints apart.
+      size_t after = data.upperBoundFrom(static_cast<app::time>(time), begin + index + 1);
+      index = std::min(after - 1 - begin, n - 2);
+    }
+    segment(k, index, time);
+  }
+}
+
+/**
+ * Handles the ranges too short to have a segment.
+ * @return true if out was filled.
+ */
+bool interpolateDegenerate(const MetricData &data, size_t begin, size_t end, size_t count, double *out) {
+  if (end - begin == 0) {
+    std::fill(out, out + count, 0.0);
+    return true;
+  }
+  if (end - begin == 1) {
+    std::fill(out, out + count, data.valueAt(begin));
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+void LinearInterpolation::interpolate(const Metric &metric,
+                                      size_t begin,
+                                      size_t end,
+                                      double timeBegin,
+                                      double increment,
+                                      size_t count,
+                                      double *out) {
+  const MetricData &data = metric.getData();
+  if (interpolateDegenerate(data, begin, end, count, out)) {
+    return;
+  }
+
+  forEachSegment(data, begin, end, timeBegin, increment, count, [&](size_t k, size_t index, double time) {
+    size_t i = begin + index;
+    double t0 = static_cast<double>(data.timeAt(i));
+    double t1 = static_cast<double>(data.timeAt(i + 1));
+    double y0 = data.valueAt(i);
+    out[k] = y0 + (data.valueAt(i + 1) - y0) * (time - t0) / (t1 - t0);
+  });
+}
+
+void CatmullRomInterpolation::interpolate(const Metric &metric,
+                                          size_t begin,
+                                          size_t end,
+                                          double timeBegin,
+                                          double increment,
+                                          size_t count,
+                                          double *out) {
+  const MetricData &data = metric.getData();
+  if (interpolateDegenerate(data, begin, end, count, out)) {
+    return;
+  }
+
+  // Slope at datapoint i, one sided at the range's edges.
+  auto tangent = [&](size_t i) {
+    size_t before = i > begin ? i - 1 : i;
+    size_t after = i + 1 < end ? i + 1 : i;
+    return (data.valueAt(after) - data.valueAt(before)) /
+        static_cast<double>(data.timeAt(after) - data.timeAt(before));
+  };
+
+  double timeFirst = static_cast<double>(data.timeAt(begin));
+  double timeLast = static_cast<double>(data.timeAt(end - 1));
+  forEachSegment(data, begin, end, timeBegin, increment, count, [&](size_t k, size_t index, double time) {
+    if (time < timeFirst) {
+      out[k] = data.valueAt(begin) + tangent(begin) * (time - timeFirst);
+      return;
+    }
+    if (time > timeLast) {
+      out[k] = data.valueAt(end - 1) + tangent(end - 1) * (time - timeLast);
+      return;
+    }
+
+    size_t i = begin + index;
+    double t0 = static_cast<double>(data.timeAt(i));
+    double h = static_cast<double>(data.timeAt(i + 1)) - t0;
+    double s = (time - t0) / h;
+    double s2 = s * s;
+    double s3 = s2 * s;
+    out[k] = (2.0 * s3 - 3.0 * s2 + 1.0) * data.valueAt(i) +
+        (s3 - 2.0 * s2 + s) * h * tangent(i) +
+        (-2.0 * s3 + 3.0 * s2) * data.valueAt(i + 1) +
+        (s3 - s2) * h * tangent(i + 1);
+  });
+}
+
+void SplineInterpolation::interpolate(const Metric &metric,
+                                      size_t begin,
+                                      size_t end,
+                                      double timeBegin,
+                                      double increment,
+                                      size_t count,
+                                      double *out) {
+  CubicSpline::interpolate(metric.getData(), begin, end, timeBegin, increment, count, out);
+}
+
+void MetricSplineInterpolation::interpolate(const Metric &metric,
+                                            size_t /* begin */,
+                                            size_t /* end */,
+                                            double timeBegin,
+                                            double increment,
+                                            size_t count,
+                                            double *out) {
+  metric.getSpline().evaluate(timeBegin, increment, count, out);
+}
@@ -0,0 +1,111 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "metric-grid.h"
+
+namespace {
+const size_t CACHE_LINE = 64;
+const size_t VALUES_PER_CACHE_LINE = CACHE_LINE / sizeof(double);
+
+size_t countColumns(app::time timeBegin, app::time timeEnd, app::time step) {
+  return (timeEnd - timeBegin) / step + 2;  // Cover timeEnd, plus one to interpolate to.
+}
+
+size_t getRowStride(size_t columnCount) {
+  return (columnCount + VALUES_PER_CACHE_LINE - 1) / VALUES_PER_CACHE_LINE * VALUES_PER_CACHE_LINE;
+}
+}  // namespace
+
+const size_t MetricGrid::DEFAULT_MAX_BYTES;
+
+size_t MetricGrid::getSizeInBytes(size_t metricCount, app::time timeBegin, app::time timeEnd, app::time step) {
+  // Columns and their cache line padding must not wrap around.
+  if ((timeEnd - timeBegin) / step >= std::numeric_limits<size_t>::max() / sizeof(double) - VALUES_PER_CACHE_LINE - 2) {
+    return std::numeric_limits<size_t>::max();
+  }
+  size_t rowBytes = getRowStride(countColumns(timeBegin, timeEnd, step)) * sizeof(double);
+  if (metricCount > 0 && rowBytes > std::numeric_limits<size_t>::max() / metricCount) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return std::max<size_t>(rowBytes * metricCount, sizeof(double));
+}
+
+MetricGrid::MetricGrid(const vector<std::shared_ptr<Metric>>& metrics,
+                       app::time timeBegin,
+                       app::time timeEnd,
+                       app::time step,
+                       size_t maxBytes) :
+    _metrics(metrics),
+    _timeBegin(timeBegin),
+    _step(step),
+    _columnCount(0),
+    _rowStride(0) {
+  if (step == 0 || timeEnd < timeBegin) {
+    throw std::invalid_argument("Time grid needs a non-zero step and timeBegin <= timeEnd.");
+  }
+
+  size_t size = getSizeInBytes(metrics.size(), timeBegin, timeEnd, step);
+  if (size > maxBytes) {
+    throw std::length_error("Time grid of " + std::to_string(metrics.size()) + " metrics would take " +
+                            std::to_string(size / (1024 * 1024)) + "MB, more than the " +
+                            std::to_string(maxBytes / (1024 * 1024)) + "MB limit. Use a larger step.");
+  }
+  this->_columnCount = countColumns(timeBegin, timeEnd, step);
+  this->_rowStride = getRowStride(this->_columnCount);
+
+  void* values = nullptr;
+  if (posix_memalign(&values, CACHE_LINE, size) != 0) {
+    throw std::bad_alloc();
+  }
+  this->_values.reset(static_cast<double*>(values));
+
+  for (size_t row = 0; row < metrics.size(); row++) {
+    this->resample(*metrics[row], this->_values.get() + row * this->_rowStride);
+  }
+}
+
+size_t MetricGrid::findRow(const std::shared_ptr<Metric>& metric) const {
+  for (size_t row = 0; row < this->_metrics.size(); row++) {
+    if (this->_metrics[row] == metric) {
+      return row;
+    }
+  }
+  throw std::invalid_argument("Metric " + metric->getMetricName() + " is not in the time grid.");
+}
+
+void MetricGrid::resample(const Metric& metric, double* row) const {
+  const Metric::DATA& data = metric.getData();
+  if (data.empty()) {
+    std::fill(row, row + this->_rowStride, 0.0);
+    return;
+  }
+
+  // Forward merge of grid columns and datapoints.
+  size_t n = data.size();
+  size_t i = 0;
+  for (size_t column = 0; column < this->_columnCount; column++) {
+    app::time time = this->_timeBegin + column * this->_step;
+    while (i + 1 < n && data.timeAt(i + 1) <= time) {
+      i++;
+    }
+
+    if (time <= data.timeAt(0)) {
+      row[column] = data.valueAt(0);
+    } else if (i + 1 == n) {
+      row[column] = data.valueAt(n - 1);
+    } else {
+      double t0 = static_cast<double>(data.timeAt(i));
+      double t1 = static_cast<double>(data.timeAt(i + 1));
+      double y0 = data.valueAt(i);
+      double y1 = data.valueAt(i + 1);
+      row[column] = y0 + (y1 - y0) * (time - t0) / (t1 - t0);
+    }
+  }
+  std::fill(row + this->_columnCount, row + this->_rowStride, 0.0);
+}
@@ -0,0 +1,27 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include "cubic-spline.h"
+#include "metric-spline.h"
+
+MetricSpline::MetricSpline(const MetricData& data) :
+    _data(data),
+    _a(data.size()),
+    _b(data.size()),
+    _c(data.size()) {
+  CubicSpline::fit(data, 0, data.size(), this->_a.data(), this->_b.data(), this->_c.data());
+}
+
+void MetricSpline::evaluate(double timeBegin, double increment, size_t count, double* out) const {
+  CubicSpline::evaluate(this->_data,
+                        0,
+                        this->_data.size(),
+                        this->_a.data(),
+                        this->_b.data(),
+                        this->_c.data(),
+                        timeBegin,
+                        increment,
+                        count,
+                        out);
+}
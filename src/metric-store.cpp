@@ -0,0 +1,199 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "metric-store.h"
+
+static_assert(sizeof(app::time) == sizeof(uint64_t), "Timestamp column is stored as uint64_t.");
+
+namespace {
+const char MAGIC[8] = { 'A', 'E', 'R', 'L', 'M', 'E', 'T', '\0' };
+const uint64_t COLUMN_ALIGNMENT = 64;
+
+uint64_t align(uint64_t offset) {
+  return (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+}
+
+void pad(std::ofstream& stream, uint64_t from, uint64_t to) {
+  static const char zeros[COLUMN_ALIGNMENT] = {};
+  stream.write(zeros, to - from);
+}
+
+/**
+ * @return Whether count items of itemSize bytes from offset end at or before limit,
+ *         without overflowing on untrusted fields.
+ */
+bool fitsBefore(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t limit) {
+  return offset <= limit && count <= (limit - offset) / itemSize;
+}
+}  // namespace
+
+MetricStore::MetricStore() :
+    _mapping(nullptr),
+    _mappingSize(0),
+    _header(nullptr),
+    _index(nullptr) {}
+
+MetricStore::~MetricStore() {
+  if (this->_mapping != nullptr) {
+    munmap(const_cast<char*>(this->_mapping), this->_mappingSize);
+  }
+}
+
+void MetricStore::write(const string& fileName, const vector<std::shared_ptr<Metric>>& metrics) {
+  std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+  if (!stream.is_open()) {
+    throw std::runtime_error("Problem opening " + fileName + " for writing.");
+  }
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.valueSize = sizeof(app::value);
+  header.metricCount = metrics.size();
+
+  vector<IndexEntry> index(metrics.size());
+  uint64_t nameTableSize = 0;
+  for (size_t i = 0; i < metrics.size(); i++) {
+    const Metric::DATA& data = metrics[i]->getData();
+    index[i].nameOffset = nameTableSize;
+    index[i].nameLength = metrics[i]->getMetricName().size();
+    index[i].pointCount = data.size();
+    index[i].firstValue = header.pointCount;
+    index[i].firstTime = header.timeCount;
+    index[i].timeBegin = data.empty() ? 0 : data.timeAt(0);
+    index[i].step = data.getStep();
+    nameTableSize += index[i].nameLength;
+    header.pointCount += data.size();
+    header.timeCount += data.isFixedStep() ? 0 : data.size();
+  }
+
+  header.indexOffset = sizeof(Header);
+  header.nameTableOffset = header.indexOffset + sizeof(IndexEntry) * index.size();
+  header.timeColumnOffset = align(header.nameTableOffset + nameTableSize);
+  header.valueColumnOffset = align(header.timeColumnOffset + sizeof(app::time) * header.timeCount);
+
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char*>(index.data()), sizeof(IndexEntry) * index.size());
+  for (const auto& metric : metrics) {
+    string name = metric->getMetricName();
+    stream.write(name.data(), name.size());
+  }
+
+  pad(stream, header.nameTableOffset + nameTableSize, header.timeColumnOffset);
+  for (const auto& metric : metrics) {
+    const Metric::DATA& data = metric->getData();
+    if (!data.isFixedStep()) {
+      stream.write(reinterpret_cast<const char*>(data.times()), sizeof(app::time) * data.size());
+    }
+  }
+
+  pad(stream, header.timeColumnOffset + sizeof(app::time) * header.timeCount, header.valueColumnOffset);
+  for (const auto& metric : metrics) {
+    const Metric::DATA& data = metric->getData();
+    stream.write(reinterpret_cast<const char*>(data.values()), sizeof(app::value) * data.size());
+  }
+
+  if (!stream) {
+    throw std::runtime_error("Problem writing " + fileName + ".");
+  }
+}
+
+std::shared_ptr<MetricStore> MetricStore::open(const string& fileName) {
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Problem opening " + fileName + ".");
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error(fileName + " is not a metric store.");
+  }
+
+  size_t mappingSize = static_cast<size_t>(fileStat.st_size);
+  void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Problem mapping " + fileName + ".");
+  }
+
+  std::shared_ptr<MetricStore> store(new MetricStore());
+  store->_mapping = static_cast<const char*>(mapping);
+  store->_mappingSize = mappingSize;
+  store->_header = reinterpret_cast<const Header*>(store->_mapping);
+
+  const Header& header = *store->_header;
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error(fileName + " is not a metric store.");
+  }
+  if (header.version != VERSION || header.valueSize != sizeof(app::value)) {
+    throw std::runtime_error(fileName + " was written by an incompatible version, convert it again.");
+  }
+
+  bool isValid =
+      fitsBefore(header.indexOffset, header.metricCount, sizeof(IndexEntry), header.nameTableOffset) &&
+      header.nameTableOffset <= header.timeColumnOffset &&
+      fitsBefore(header.timeColumnOffset, header.timeCount, sizeof(app::time), header.valueColumnOffset) &&
+      fitsBefore(header.valueColumnOffset, header.pointCount, sizeof(app::value), mappingSize);
+  if (!isValid) {
+    throw std::runtime_error(fileName + " is truncated or corrupted.");
+  }
+
+  store->_index = reinterpret_cast<const IndexEntry*>(store->_mapping + header.indexOffset);
+  for (size_t i = 0; i < header.metricCount; i++) {
+    const IndexEntry& entry = store->_index[i];
+    bool hasTimes = entry.step == 0;
+    uint64_t nameTableSize = header.timeColumnOffset - header.nameTableOffset;
+    if (!fitsBefore(entry.nameOffset, entry.nameLength, 1, nameTableSize) ||
+        !fitsBefore(entry.firstValue, entry.pointCount, 1, header.pointCount) ||
+        (hasTimes && !fitsBefore(entry.firstTime, entry.pointCount, 1, header.timeCount))) {
+      throw std::runtime_error(fileName + " is truncated or corrupted.");
+    }
+  }
+
+  return store;
+}
+
+bool MetricStore::isMetricStore(const string& fileName) {
+  std::ifstream stream(fileName, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  if (!stream.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+size_t MetricStore::size() const {
+  return this->_header->metricCount;
+}
+
+vector<std::shared_ptr<Metric>> MetricStore::getMetrics() {
+  const Header& header = *this->_header;
+  const app::time* times = reinterpret_cast<const app::time*>(this->_mapping + header.timeColumnOffset);
+  const app::value* values = reinterpret_cast<const app::value*>(this->_mapping + header.valueColumnOffset);
+  std::shared_ptr<const void> owner = this->shared_from_this();
+
+  vector<std::shared_ptr<Metric>> metrics;
+  metrics.reserve(header.metricCount);
+  for (size_t i = 0; i < header.metricCount; i++) {
+    const IndexEntry& entry = this->_index[i];
+    string name(this->_mapping + header.nameTableOffset + entry.nameOffset, entry.nameLength);
+    Metric::DATA data = entry.step == 0 ?
+        Metric::DATA(times + entry.firstTime, values + entry.firstValue, entry.pointCount, owner) :
+        Metric::DATA(entry.timeBegin, entry.step, values + entry.firstValue, entry.pointCount, owner);
+    metrics.push_back(std::shared_ptr<Metric>(new Metric(name, std::move(data), i)));
+  }
+
+  return metrics;
+}
@@ -0,0 +1,342 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "metric-stream-parser.h"
+
+MetricStreamParser::MetricStreamParser(std::istream& stream, size_t bufferSize) :
+    _stream(stream),
+    _buffer(bufferSize),
+    _position(0),
+    _size(0),
+    _offset(0),
+    _begun(false),
+    _ended(false) {}
+
+bool MetricStreamParser::next(string& target,
+                              bool& hasTarget,
+                              vector<app::time>& times,
+                              vector<app::value>& values) {
+  target.clear();
+  hasTarget = false;
+  times.clear();
+  values.clear();
+
+  if (this->_ended) {
+    return false;
+  }
+
+  this->skipWhitespace();
+  if (!this->_begun) {
+    this->expect('[');
+    this->_begun = true;
+    this->skipWhitespace();
+    if (this->peek() == ']') {
+      this->get();
+      this->expectEnd();
+      return false;
+    }
+  } else {
+    int c = this->get();
+    if (c == ']') {
+      this->expectEnd();
+      return false;
+    }
+    if (c != ',') {
+      this->fail("expected ',' or ']' between metrics");
+    }
+    this->skipWhitespace();
+  }
+
+  this->expect('{');
+  this->skipWhitespace();
+  if (this->peek() == '}') {
+    this->get();
+    return true;
+  }
+
+  string key;
+  while (true) {
+    this->parseString(key);
+    this->skipWhitespace();
+    this->expect(':');
+    this->skipWhitespace();
+
+    if (key == "target") {
+      if (this->peek() == 'n') {
+        this->expectLiteral("null");
+      } else {
+        this->parseString(target);
+        hasTarget = true;
+      }
+    } else if (key == "datapoints") {
+      this->parseDatapoints(times, values);
+    } else {
+      this->skipValue();
+    }
+
+    this->skipWhitespace();
+    int c = this->get();
+    if (c == '}') {
+      break;
+    }
+    if (c != ',') {
+      this->fail("expected ',' or '}' in metric");
+    }
+    this->skipWhitespace();
+  }
+
+  return true;
+}
+
+void MetricStreamParser::expectEnd() {
+  this->_ended = true;
+  this->skipWhitespace();
+  if (this->peek() != -1) {
+    this->fail("trailing data after the metric array");
+  }
+}
+
+bool MetricStreamParser::fill() {
+  this->_offset += this->_size;
+  this->_position = 0;
+  this->_size = 0;
+  if (!this->_stream) {
+    return false;
+  }
+
+  this->_stream.read(this->_buffer.data(), this->_buffer.size());
+  this->_size = static_cast<size_t>(this->_stream.gcount());
+  return this->_size > 0;
+}
+
+int MetricStreamParser::peek() {
+  if (this->_position == this->_size && !this->fill()) {
+    return -1;
+  }
+  return static_cast<unsigned char>(this->_buffer[this->_position]);
+}
+
+int MetricStreamParser::get() {
+  int c = this->peek();
+  if (c != -1) {
+    this->_position++;
+  }
+  return c;
+}
+
+void MetricStreamParser::skipWhitespace() {
+  while (true) {
+    int c = this->peek();
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      return;
+    }
+    this->_position++;
+  }
+}
+
+void MetricStreamParser::expect(char c) {
+  if (this->get() != c) {
+    this->fail(string("expected '") + c + "'");
+  }
+}
+
+void MetricStreamParser::expectLiteral(const char* literal) {
+  for (; *literal != '\0'; literal++) {
+    this->expect(*literal);
+  }
+}
+
+void MetricStreamParser::parseString(string& out) {
+  out.clear();
+  this->expect('"');
+  while (true) {
+    int c = this->get();
+    if (c == -1) {
+      this->fail("unterminated string");
+    }
+    if (c == '"') {
+      return;
+    }
+    if (c != '\\') {
+      out.push_back(static_cast<char>(c));
+      continue;
+    }
+
+    c = this->get();
+    switch (c) {
+      case '"': out.push_back('"'); break;
+      case '\\': out.push_back('\\'); break;
+      case '/': out.push_back('/'); break;
+      case 'b': out.push_back('\b'); break;
+      case 'f': out.push_back('\f'); break;
+      case 'n': out.push_back('\n'); break;
+      case 'r': out.push_back('\r'); break;
+      case 't': out.push_back('\t'); break;
+      case 'u': {
+        unsigned long codePoint = this->parseHex4();
+        if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+          this->fail("unpaired low surrogate in \\u escape");
+        }
+        if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+          // A high surrogate must be followed by a \u escaped low one, they make one code point.
+          if (this->get() != '\\' || this->get() != 'u') {
+            this->fail("unpaired high surrogate in \\u escape");
+          }
+          unsigned long low = this->parseHex4();
+          if (low < 0xDC00 || low > 0xDFFF) {
+            this->fail("unpaired high surrogate in \\u escape");
+          }
+          codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        // Encode as UTF-8.
+        if (codePoint < 0x80) {
+          out.push_back(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+          out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+          out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else if (codePoint < 0x10000) {
+          out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+          out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else {
+          out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+          out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        break;
+      }
+      default:
+        this->fail("invalid escape sequence");
+    }
+  }
+}
+
+unsigned long MetricStreamParser::parseHex4() {
+  unsigned long codeUnit = 0;
+  for (int i = 0; i < 4; i++) {
+    int h = this->get();
+    codeUnit <<= 4;
+    if (h >= '0' && h <= '9') {
+      codeUnit |= h - '0';
+    } else if (h >= 'a' && h <= 'f') {
+      codeUnit |= h - 'a' + 10;
+    } else if (h >= 'A' && h <= 'F') {
+      codeUnit |= h - 'A' + 10;
+    } else {
+      this->fail("invalid \\u escape");
+    }
+  }
+  return codeUnit;
+}
+
+double MetricStreamParser::parseNumber() {
+  char token[64];
+  size_t length = 0;
+  while (true) {
+    int c = this->peek();
+    bool isNumberChar = (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    if (!isNumberChar) {
+      break;
+    }
+    if (length == sizeof(token) - 1) {
+      this->fail("number too long");
+    }
+    token[length++] = static_cast<char>(c);
+    this->_position++;
+  }
+  token[length] = '\0';
+
+  char* end = nullptr;
+  double value = std::strtod(token, &end);
+  if (length == 0 || end != token + length) {
+    this->fail("invalid number");
+  }
+  return value;
+}
+
+void MetricStreamParser::parseDatapoints(vector<app::time>& times, vector<app::value>& values) {
+  this->expect('[');
+  this->skipWhitespace();
+  if (this->peek() == ']') {
+    this->get();
+    return;
+  }
+
+  while (true) {
+    this->expect('[');
+    this->skipWhitespace();
+
+    app::value y = 0;
+    if (this->peek() == 'n') {
+      this->expectLiteral("null");
+    } else {
+      y = this->parseNumber();
+    }
+    this->skipWhitespace();
+    this->expect(',');
+    this->skipWhitespace();
+    app::time x = static_cast<app::time>(this->parseNumber());
+    this->skipWhitespace();
+    this->expect(']');
+
+    values.push_back(y);
+    times.push_back(x);
+
+    this->skipWhitespace();
+    int c = this->get();
+    if (c == ']') {
+      return;
+    }
+    if (c != ',') {
+      this->fail("expected ',' or ']' in datapoints");
+    }
+    this->skipWhitespace();
+  }
+}
+
+void MetricStreamParser::skipValue() {
+  int c = this->peek();
+  if (c == '"') {
+    string ignored;
+    this->parseString(ignored);
+  } else if (c == '[' || c == '{') {
+    // Skip nested containers by depth, strings may contain brackets.
+    size_t depth = 0;
+    do {
+      c = this->peek();
+      if (c == -1) {
+        this->fail("unterminated container");
+      }
+      if (c == '"') {
+        string ignored;
+        this->parseString(ignored);
+        continue;
+      }
+      if (c == '[' || c == '{') {
+        depth++;
+      } else if (c == ']' || c == '}') {
+        depth--;
+      }
+      this->_position++;
+    } while (depth > 0);
+  } else if (c == 't') {
+    this->expectLiteral("true");
+  } else if (c == 'f') {
+    this->expectLiteral("false");
+  } else if (c == 'n') {
+    this->expectLiteral("null");
+  } else {
+    this->parseNumber();
+  }
+}
+
+void MetricStreamParser::fail(const string& reason) const {
+  throw std::domain_error(
+      "Invalid metric json at byte " + std::to_string(this->_offset + this->_position) + ": " + reason);
+}
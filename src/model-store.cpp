@@ -0,0 +1,251 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "model-store.h"
+#include "q-model.h"
+
+namespace {
+const char MAGIC[8] = { 'A', 'E', 'R', 'L', 'M', 'D', 'L', '\0' };
+const uint64_t COLUMN_ALIGNMENT = 64;
+
+uint64_t align(uint64_t offset) {
+  return (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+}
+
+void pad(std::ofstream& stream, uint64_t from, uint64_t to) {
+  static const char zeros[COLUMN_ALIGNMENT] = {};
+  stream.write(zeros, to - from);
+}
+
+/**
+ * @return Whether count items of itemSize bytes starting at offset end at or before
+ *         limit, without overflowing.
+ */
+bool fitsBefore(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t limit) {
+  return offset <= limit && count <= (limit - offset) / itemSize;
+}
+}  // namespace
+
+ModelStore::ModelStore() :
+    _mapping(nullptr),
+    _mappingSize(0),
+    _header(nullptr),
+    _keys(nullptr),
+    _weights(nullptr) {}
+
+ModelStore::~ModelStore() {
+  if (this->_mapping != nullptr) {
+    munmap(const_cast<char*>(this->_mapping), this->_mappingSize);
+  }
+}
+
+void ModelStore::write(const string &fileName,
+                       const QModel &model,
+                       const vector<std::shared_ptr<Metric>> &metrics) {
+  std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+  if (!stream.is_open()) {
+    throw std::runtime_error("Problem opening " + fileName + " for writing.");
+  }
+
+  // Index entry i is the metric trained with index i.
+  size_t metricCount = app::getMetricDimension(metrics);
+  vector<string> names(metricCount);
+  for (const auto &metric : metrics) {
+    names[metric->getMetricIndex()] = metric->getMetricName();
+  }
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.weightSize = sizeof(rl::FLOAT);
+  header.modelSize = model.getSize();
+  header.numTilings = model.getNumTilings();
+  header.metricCount = metricCount;
+  header.isSparse = model.isSparse();
+  header.initialWeight = model.getInitialWeight();
+  header.tileCoder = static_cast<uint32_t>(model.getTileCoder());
+
+  vector<uint64_t> keys;
+  vector<rl::FLOAT> weights;
+  if (model.isSparse()) {
+    model.getChangedWeights(keys, weights);
+  }
+  header.weightCount = model.isSparse() ? weights.size() : model.getSize();
+
+  vector<IndexEntry> index(metricCount);
+  uint64_t nameTableSize = 0;
+  for (size_t i = 0; i < metricCount; i++) {
+    index[i].nameOffset = nameTableSize;
+    index[i].nameLength = names[i].size();
+    nameTableSize += index[i].nameLength;
+  }
+
+  header.indexOffset = sizeof(Header);
+  header.nameTableOffset = header.indexOffset + sizeof(IndexEntry) * index.size();
+  header.keyColumnOffset = align(header.nameTableOffset + nameTableSize);
+  header.weightColumnOffset = model.isSparse() ?
+      align(header.keyColumnOffset + sizeof(uint64_t) * keys.size()) :
+      header.keyColumnOffset;
+
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char*>(index.data()), sizeof(IndexEntry) * index.size());
+  for (const auto &name : names) {
+    stream.write(name.data(), name.size());
+  }
+
+  pad(stream, header.nameTableOffset + nameTableSize, header.keyColumnOffset);
+  if (model.isSparse()) {
+    stream.write(reinterpret_cast<const char*>(keys.data()), sizeof(uint64_t) * keys.size());
+    pad(stream, header.keyColumnOffset + sizeof(uint64_t) * keys.size(), header.weightColumnOffset);
+    stream.write(reinterpret_cast<const char*>(weights.data()), sizeof(rl::FLOAT) * weights.size());
+  } else {
+    const size_t BLOCK_SIZE = 1 << 16;
+    vector<rl::FLOAT> block(BLOCK_SIZE);
+    for (size_t blockBegin = 0; blockBegin < header.modelSize; blockBegin += BLOCK_SIZE) {
+      size_t blockSize = std::min<size_t>(BLOCK_SIZE, header.modelSize - blockBegin);
+      for (size_t i = 0; i < blockSize; i++) {
+        block[i] = model.getWeight(blockBegin + i);
+      }
+      stream.write(reinterpret_cast<const char*>(block.data()), sizeof(rl::FLOAT) * blockSize);
+    }
+  }
+
+  if (!stream) {
+    throw std::runtime_error("Problem writing " + fileName + ".");
+  }
+}
+
+std::shared_ptr<ModelStore> ModelStore::open(const string &fileName) {
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Problem opening " + fileName + ".");
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error(fileName + " is not a model.");
+  }
+
+  size_t mappingSize = static_cast<size_t>(fileStat.st_size);
+  void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Problem mapping " + fileName + ".");
+  }
+
+  std::shared_ptr<ModelStore> store(new ModelStore());
+  store->_mapping = static_cast<const char*>(mapping);
+  store->_mappingSize = mappingSize;
+  store->_header = reinterpret_cast<const Header*>(store->_mapping);
+
+  const Header& header = *store->_header;
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error(fileName + " is not a model.");
+  }
+  if (header.version < VERSION) {
+    // Before version 4, models were tile coded by TileCodeMurMur and didn't say so.
+    throw std::runtime_error(fileName + " was written by an older version (" + std::to_string(header.version) +
+                             ") without its tile coder, train it again.");
+  }
+  if (header.version != VERSION || header.weightSize != sizeof(rl::FLOAT)) {
+    throw std::runtime_error(fileName + " was written by an incompatible version, train it again.");
+  }
+  if (header.tileCoder > static_cast<uint32_t>(app::TileCoder::MURMUR)) {
+    throw std::runtime_error(fileName + " is truncated or corrupted.");
+  }
+
+  // Tables are sized by app::getTableSize, a power of 2.
+  bool isValid =
+      header.modelSize > 0 && (header.modelSize & (header.modelSize - 1)) == 0 &&
+      header.metricCount > 0 &&
+      header.indexOffset >= sizeof(Header) &&
+      fitsBefore(header.indexOffset, header.metricCount, sizeof(IndexEntry), header.nameTableOffset) &&
+      header.nameTableOffset <= header.keyColumnOffset &&
+      fitsBefore(header.keyColumnOffset, header.isSparse ? header.weightCount : 0, sizeof(uint64_t),
+                 header.weightColumnOffset) &&
+      fitsBefore(header.weightColumnOffset, header.weightCount, sizeof(rl::FLOAT), mappingSize) &&
+      (header.isSparse || header.weightCount == header.modelSize);
+  if (!isValid) {
+    throw std::runtime_error(fileName + " is truncated or corrupted.");
+  }
+
+  const IndexEntry* index = reinterpret_cast<const IndexEntry*>(store->_mapping + header.indexOffset);
+  uint64_t nameTableSize = header.keyColumnOffset - header.nameTableOffset;
+  for (size_t i = 0; i < header.metricCount; i++) {
+    if (!fitsBefore(index[i].nameOffset, index[i].nameLength, 1, nameTableSize)) {
+      throw std::runtime_error(fileName + " is truncated or corrupted.");
+    }
+    if (index[i].nameLength > 0) {
+      string name(store->_mapping + header.nameTableOffset + index[i].nameOffset, index[i].nameLength);
+      store->_metricIndices[name] = i;
+    }
+  }
+
+  store->_keys = reinterpret_cast<const uint64_t*>(store->_mapping + header.keyColumnOffset);
+  store->_weights = reinterpret_cast<const rl::FLOAT*>(store->_mapping + header.weightColumnOffset);
+  try {
+    store->_tileCode = app::createTileCode(header.metricCount, header.modelSize,
+                                           static_cast<app::TileCoder>(header.tileCoder));
+  } catch(std::domain_error& e) {
+    throw std::runtime_error(fileName + " is truncated or corrupted, " + e.what());
+  }
+  if (store->_tileCode->getSize() != header.modelSize || store->_tileCode->getNumTilings() != header.numTilings) {
+    throw std::runtime_error(fileName + " was trained with another tile coding.");
+  }
+  // Scoring reads a handful of weights per metric, scattered over the table.
+  madvise(const_cast<char*>(store->_mapping), mappingSize, MADV_RANDOM);
+
+  return store;
+}
+
+bool ModelStore::findMetricIndex(const string &metricName, size_t &metricIndex) const {
+  auto found = this->_metricIndices.find(metricName);
+  if (found == this->_metricIndices.end()) {
+    return false;
+  }
+  metricIndex = found->second;
+  return true;
+}
+
+size_t ModelStore::getMetricCount() const {
+  return this->_metricIndices.size();
+}
+
+rl::FLOAT ModelStore::getValue(const rl::floatVector &state, const rl::floatVector &action) const {
+  rl::floatVector stateAction;
+  stateAction.reserve(state.size() + action.size());
+  stateAction.insert(stateAction.end(), state.begin(), state.end());
+  stateAction.insert(stateAction.end(), action.begin(), action.end());
+
+  rl::FLOAT value = 0;
+  for (auto f : this->_tileCode->getFeatureVector(stateAction)) {
+    value += this->getWeight(f);
+  }
+  return value;
+}
+
+rl::FLOAT ModelStore::getWeight(uint64_t feature) const {
+  const Header& header = *this->_header;
+  if (!header.isSparse) {
+    return this->_weights[feature];
+  }
+
+  const uint64_t* key = std::lower_bound(this->_keys, this->_keys + header.weightCount, feature);
+  return key != this->_keys + header.weightCount && *key == feature ?
+      this->_weights[key - this->_keys] :
+      header.initialWeight;
+}
@@ -0,0 +1,201 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+
+// The SIMD kernels are compiled for their instruction set whatever the
+// target is, and only run if the CPU supports it.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PATTERN_DISTANCE_X86
+#include <immintrin.h>
+#endif
+
+#include "pattern-distance.h"
+
+constexpr size_t PatternDistance::LANES;
+
+namespace {
+
+typedef void (*DistanceFunction)(const float*, const float*, size_t, size_t, float*);
+
+template <bool ABSOLUTE>
+void scalarDistance(const float* goal, const float* candidates, size_t count, size_t resolution, float* out) {
+  size_t size = PatternDistance::paddedSize(resolution);
+  for (size_t c = 0; c < count; c++) {
+    const float* candidate = candidates + c * size;
+    float sum = 0.0f;
+    for (size_t i = 0; i < resolution; i++) {
+      float diff = goal[i] - candidate[i];
+      sum += ABSOLUTE ? std::abs(diff) : diff;
+    }
+    out[c] = sum / resolution;
+  }
+}
+
+#if defined(PATTERN_DISTANCE_X86)
+
+/**
+ * Sums the 8 lanes of each of the 8 vectors, result c in lane c.
+ */
+__attribute__((target("avx")))
+inline __m256 horizontalSum(const __m256* sums) {
+  __m256 s01 = _mm256_hadd_ps(sums[0], sums[1]);
+  __m256 s23 = _mm256_hadd_ps(sums[2], sums[3]);
+  __m256 s45 = _mm256_hadd_ps(sums[4], sums[5]);
+  __m256 s67 = _mm256_hadd_ps(sums[6], sums[7]);
+  __m256 s0123 = _mm256_hadd_ps(s01, s23);
+  __m256 s4567 = _mm256_hadd_ps(s45, s67);
+  return _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20),
+                       _mm256_permute2f128_ps(s0123, s4567, 0x31));
+}
+
+template <bool ABSOLUTE>
+__attribute__((target("avx")))
+void avxDistance(const float* goal, const float* candidates, size_t count, size_t resolution, float* out) {
+  const size_t size = PatternDistance::paddedSize(resolution);
+  const __m256 signMask = _mm256_set1_ps(-0.0f);
+  const __m256 divisor = _mm256_set1_ps(static_cast<float>(resolution));
+
+  // Blocks of 8 candidates, reduced together.
+  size_t c = 0;
+  for (; c + 8 <= count; c += 8) {
+    const float* block = candidates + c * size;
+    __m256 sums[8];
+    for (size_t k = 0; k < 8; k++) {
+      sums[k] = _mm256_setzero_ps();
+    }
+    for (size_t i = 0; i < size; i += 8) {
+      __m256 g = _mm256_loadu_ps(goal + i);
+      for (size_t k = 0; k < 8; k++) {
+        __m256 diff = _mm256_sub_ps(g, _mm256_loadu_ps(block + k * size + i));
+        sums[k] = _mm256_add_ps(sums[k], ABSOLUTE ? _mm256_andnot_ps(signMask, diff) : diff);
+      }
+    }
+    _mm256_storeu_ps(out + c, _mm256_div_ps(horizontalSum(sums), divisor));
+  }
+
+  for (; c < count; c++) {
+    const float* candidate = candidates + c * size;
+    __m256 sums[8] = {};
+    for (size_t i = 0; i < size; i += 8) {
+      __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(goal + i), _mm256_loadu_ps(candidate + i));
+      sums[0] = _mm256_add_ps(sums[0], ABSOLUTE ? _mm256_andnot_ps(signMask, diff) : diff);
+    }
+    out[c] = _mm256_cvtss_f32(horizontalSum(sums)) / resolution;
+  }
+}
+
+template <bool ABSOLUTE>
+__attribute__((target("sse2")))
+void sse2Distance(const float* goal, const float* candidates, size_t count, size_t resolution, float* out) {
+  const size_t size = PatternDistance::paddedSize(resolution);
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+  const __m128 divisor = _mm_set1_ps(static_cast<float>(resolution));
+
+  // Blocks of 4 candidates, reduced together.
+  size_t c = 0;
+  for (; c + 4 <= count; c += 4) {
+    const float* block = candidates + c * size;
+    __m128 sums[4];
+    for (size_t k = 0; k < 4; k++) {
+      sums[k] = _mm_setzero_ps();
+    }
+    for (size_t i = 0; i < size; i += 4) {
+      __m128 g = _mm_loadu_ps(goal + i);
+      for (size_t k = 0; k < 4; k++) {
+        __m128 diff = _mm_sub_ps(g, _mm_loadu_ps(block + k * size + i));
+        sums[k] = _mm_add_ps(sums[k], ABSOLUTE ? _mm_andnot_ps(signMask, diff) : diff);
+      }
+    }
+    _MM_TRANSPOSE4_PS(sums[0], sums[1], sums[2], sums[3]);
+    __m128 sum = _mm_add_ps(_mm_add_ps(sums[0], sums[1]), _mm_add_ps(sums[2], sums[3]));
+    _mm_storeu_ps(out + c, _mm_div_ps(sum, divisor));
+  }
+
+  for (; c < count; c++) {
+    const float* candidate = candidates + c * size;
+    __m128 sum = _mm_setzero_ps();
+    for (size_t i = 0; i < size; i += 4) {
+      __m128 diff = _mm_sub_ps(_mm_loadu_ps(goal + i), _mm_loadu_ps(candidate + i));
+      sum = _mm_add_ps(sum, ABSOLUTE ? _mm_andnot_ps(signMask, diff) : diff);
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    out[c] = _mm_cvtss_f32(sum) / resolution;
+  }
+}
+
+#endif
+
+DistanceFunction getDistance(PatternDistance::Kernel kernel, bool absolute) {
+  switch (kernel) {
+#if defined(PATTERN_DISTANCE_X86)
+    case PatternDistance::Kernel::AVX:
+      return absolute ? avxDistance<true> : avxDistance<false>;
+    case PatternDistance::Kernel::SSE2:
+      return absolute ? sse2Distance<true> : sse2Distance<false>;
+#endif
+    default:
+      return absolute ? scalarDistance<true> : scalarDistance<false>;
+  }
+}
+
+}  // namespace
+
+bool PatternDistance::isSupported(Kernel kernel) {
+  switch (kernel) {
+#if defined(PATTERN_DISTANCE_X86)
+    case Kernel::AVX:
+      return __builtin_cpu_supports("avx");
+    case Kernel::SSE2:
+      return __builtin_cpu_supports("sse2");
+#endif
+    case Kernel::SCALAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+PatternDistance::Kernel PatternDistance::getBestKernel() {
+  static const Kernel best = isSupported(Kernel::AVX) ? Kernel::AVX :
+                             isSupported(Kernel::SSE2) ? Kernel::SSE2 : Kernel::SCALAR;
+  return best;
+}
+
+void PatternDistance::absoluteArea(const float* goal,
+                                   const float* candidates,
+                                   size_t count,
+                                   size_t resolution,
+                                   float* out) {
+  static const DistanceFunction distance = getDistance(getBestKernel(), true);
+  distance(goal, candidates, count, resolution, out);
+}
+
+void PatternDistance::area(const float* goal,
+                           const float* candidates,
+                           size_t count,
+                           size_t resolution,
+                           float* out) {
+  static const DistanceFunction distance = getDistance(getBestKernel(), false);
+  distance(goal, candidates, count, resolution, out);
+}
+
+void PatternDistance::absoluteArea(Kernel kernel,
+                                   const float* goal,
+                                   const float* candidates,
+                                   size_t count,
+                                   size_t resolution,
+                                   float* out) {
+  getDistance(kernel, true)(goal, candidates, count, resolution, out);
+}
+
+void PatternDistance::area(Kernel kernel,
+                           const float* goal,
+                           const float* candidates,
+                           size_t count,
+                           size_t resolution,
+                           float* out) {
+  getDistance(kernel, false)(goal, candidates, count, resolution, out);
+}
@@ -0,0 +1,49 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include "pattern-status.h"
+
+namespace app {
+
+const char* getPatternStatusMessage(PatternStatus status) {
+  switch (status) {
+    case PatternStatus::OK:
+      return "Pattern extracted";
+    case PatternStatus::AFTER_METRIC_END:
+      return "time exceeded Metric::getTimeEnd()";
+    case PatternStatus::BEFORE_METRIC_BEGIN:
+      return "time is less than Metric::getTimeBegin()";
+    case PatternStatus::NOT_ENOUGH_RESOLUTION:
+    default:
+      return "Not enough resolution";
+  }
+}
+
+std::string getPatternStatusName(PatternStatus status) {
+  switch (status) {
+    case PatternStatus::OK:
+      return "ok";
+    case PatternStatus::AFTER_METRIC_END:
+      return "afterMetricEnd";
+    case PatternStatus::BEFORE_METRIC_BEGIN:
+      return "beforeMetricBegin";
+    case PatternStatus::NOT_ENOUGH_RESOLUTION:
+    default:
+      return "notEnoughResolution";
+  }
+}
+
+std::string PatternStatusCounts::getRejectionSummary() const {
+  std::string summary;
+  for (size_t s = 0; s < static_cast<size_t>(PatternStatus::COUNT); s++) {
+    auto status = static_cast<PatternStatus>(s);
+    if (status == PatternStatus::OK || this->_counts[s] == 0) {
+      continue;
+    }
+    summary += (summary.empty() ? "" : ", ") + getPatternStatusName(status) + " " + std::to_string(this->_counts[s]);
+  }
+  return summary.empty() ? "none" : summary;
+}
+
+}  // namespace app
@@ -0,0 +1,161 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+
+#include "q-model.h"
+#include "metric.h"
+
+QModel::QModel(const rl::coding::TileCode &tileCode,
+               rl::FLOAT stepSize,
+               rl::FLOAT discountRate,
+               rl::FLOAT initialValue,
+               Storage storage,
+               size_t sparseCapacity) :
+    _tileCode(tileCode),
+    _patternTileCode(dynamic_cast<const app::PATTERN_TILE_CODE*>(&tileCode)),
+    _stepSize(stepSize),
+    _discountRate(discountRate),
+    _initialValue(initialValue),
+    _initialWeight(initialValue / tileCode.getNumTilings()),
+    _size(tileCode.getSize()),
+    _storage(storage) {
+  switch (storage) {
+    case Storage::DENSE:
+      this->_weights.reset(new std::atomic<rl::FLOAT>[tileCode.getSize()]);
+      break;
+    case Storage::SPARSE:
+      this->_sparseWeights.reset(new SparseWeights(this->_initialWeight, sparseCapacity));
+      break;
+    case Storage::HALF:
+      this->_halfWeights.reset(new std::atomic<uint16_t>[tileCode.getSize()]);
+      break;
+  }
+  this->reset();
+}
+
+void QModel::reset() {
+  switch (this->_storage) {
+    case Storage::DENSE:
+      for (size_t i = 0; i < this->_size; i++) {
+        this->_weights[i].store(this->_initialWeight, std::memory_order_relaxed);
+      }
+      break;
+    case Storage::SPARSE:
+      this->_sparseWeights->clear();
+      break;
+    case Storage::HALF:
+      for (size_t i = 0; i < this->_size; i++) {
+        this->_halfWeights[i].store(0, std::memory_order_relaxed);
+      }
+      break;
+  }
+}
+
+void QModel::getChangedWeights(std::vector<uint64_t> &indices, std::vector<rl::FLOAT> &weights) const {
+  indices.clear();
+  weights.clear();
+  rl::FLOAT initialWeight = this->getInitialWeight();
+
+  if (this->_sparseWeights) {
+    std::vector<std::pair<uint64_t, rl::FLOAT>> changed;
+    changed.reserve(this->_sparseWeights->size());
+    this->_sparseWeights->forEach([&](uint64_t index, rl::FLOAT weight) {
+      if (weight != initialWeight) {
+        changed.emplace_back(index, weight);
+      }
+    });
+    std::sort(changed.begin(), changed.end());
+    for (auto &c : changed) {
+      indices.push_back(c.first);
+      weights.push_back(c.second);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < this->_size; i++) {
+    rl::FLOAT weight = this->getWeight(i);
+    if (weight != initialWeight) {
+      indices.push_back(i);
+      weights.push_back(weight);
+    }
+  }
+}
+
+void QModel::copyTable(std::vector<rl::FLOAT> &weights, std::vector<uint16_t> &halfWeights) const {
+  weights.clear();
+  halfWeights.clear();
+  switch (this->_storage) {
+    case Storage::DENSE:
+      weights.resize(this->_size);
+      for (size_t i = 0; i < this->_size; i++) {
+        weights[i] = this->_weights[i].load(std::memory_order_relaxed);
+      }
+      break;
+    case Storage::HALF:
+      halfWeights.resize(this->_size);
+      for (size_t i = 0; i < this->_size; i++) {
+        halfWeights[i] = this->_halfWeights[i].load(std::memory_order_relaxed);
+      }
+      break;
+    case Storage::SPARSE:
+      break;
+  }
+}
+
+rl::FLOAT QModel::getValue(const rl::floatVector &state, const rl::floatVector &action) const {
+  return this->getValue(this->getFeatureVector(state, action));
+}
+
+void QModel::update(const rl::floatVector &state,
+                    const rl::floatVector &action,
+                    rl::FLOAT reward,
+                    const rl::floatVector &nextState) {
+  auto features = this->getFeatureVector(state, action);
+  rl::FLOAT increment = this->getIncrement(features, reward, this->getValue(nextState, action));
+  for (auto f : features) {
+    this->addIncrement(f, increment);
+  }
+}
+
+rl::FLOAT QModel::getIncrement(const size_t* features, rl::FLOAT reward, rl::FLOAT nextValue) const {
+  rl::FLOAT tdError = reward + this->_discountRate * nextValue - this->getValue(features);
+  return this->_stepSize / this->_tileCode.getNumTilings() * tdError;
+}
+
+rl::FEATURE_VECTOR QModel::getFeatureVector(const rl::floatVector &state, const rl::floatVector &action) const {
+  rl::floatVector stateAction;
+  stateAction.reserve(state.size() + action.size());
+  stateAction.insert(stateAction.end(), state.begin(), state.end());
+  stateAction.insert(stateAction.end(), action.begin(), action.end());
+  return this->_tileCode.getFeatureVector(stateAction);
+}
+
+void QModel::getFeatures(const PlotPattern<app::PATTERN_SIZE> &pattern, size_t* features) const {
+  this->getFeatures(pattern.getFeatures(), pattern.getMetric()->getMetricIndex(), features);
+}
+
+void QModel::getFeatures(const PatternFeatures<app::PATTERN_SIZE> &patternFeatures,
+                         size_t metricIndex,
+                         size_t* features) const {
+  if (this->_patternTileCode != nullptr) {
+    this->_patternTileCode->getFeatures(patternFeatures.y, metricIndex, features);
+    return;
+  }
+
+  // Same state as PlotPattern::getGradientDescentParameters.
+  rl::floatVector state(patternFeatures.y, patternFeatures.y + app::PATTERN_SIZE);
+  state.push_back(static_cast<rl::FLOAT>(metricIndex));
+  auto featureVector = this->getFeatureVector(state, *app::goalAction);
+  std::copy(featureVector.begin(), featureVector.end(), features);
+}
+
+rl::FLOAT QModel::getValue(const size_t* features) const {
+  rl::FLOAT value = 0;
+  size_t numTilings = this->_tileCode.getNumTilings();
+  for (size_t f = 0; f < numTilings; f++) {
+    value += this->getWeight(features[f]);
+  }
+  return value;
+}
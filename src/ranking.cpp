@@ -0,0 +1,70 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "ranking.h"
+
+std::vector<size_t> Ranking::getTop(const std::vector<rl::FLOAT> &values, size_t k) {
+  std::vector<size_t> indices(values.size());
+  for (size_t i = 0; i < indices.size(); i++) {
+    indices[i] = i;
+  }
+
+  k = std::min(k, values.size());
+  auto greater = [&values](size_t a, size_t b) {
+    return values[a] > values[b] || (values[a] == values[b] && a < b);
+  };
+  std::partial_sort(indices.begin(), indices.begin() + k, indices.end(), greater);
+  indices.resize(k);
+  return indices;
+}
+
+double Ranking::getKendallTau(const std::vector<rl::FLOAT> &reference,
+                              const std::vector<rl::FLOAT> &values,
+                              size_t k) {
+  auto top = Ranking::getTop(reference, k);
+
+  // O(k^2) pair count, k is the few hundred reported metrics.
+  double concordant = 0;
+  double discordant = 0;
+  double referenceTies = 0;
+  double valueTies = 0;
+  for (size_t i = 0; i < top.size(); i++) {
+    for (size_t j = i + 1; j < top.size(); j++) {
+      rl::FLOAT referenceDelta = reference[top[i]] - reference[top[j]];
+      rl::FLOAT valueDelta = values[top[i]] - values[top[j]];
+      if (referenceDelta == 0 && valueDelta == 0) {
+        continue;
+      } else if (referenceDelta == 0) {
+        referenceTies++;
+      } else if (valueDelta == 0) {
+        valueTies++;
+      } else if ((referenceDelta > 0) == (valueDelta > 0)) {
+        concordant++;
+      } else {
+        discordant++;
+      }
+    }
+  }
+
+  double denominator = std::sqrt((concordant + discordant + referenceTies) * (concordant + discordant + valueTies));
+  return denominator == 0 ? 0 : (concordant - discordant) / denominator;
+}
+
+double Ranking::getTopOverlap(const std::vector<rl::FLOAT> &a, const std::vector<rl::FLOAT> &b, size_t k) {
+  auto topA = Ranking::getTop(a, k);
+  auto topB = Ranking::getTop(b, k);
+  if (topA.empty()) {
+    return 1;
+  }
+
+  std::sort(topA.begin(), topA.end());
+  std::sort(topB.begin(), topB.end());
+  std::vector<size_t> common;
+  std::set_intersection(topA.begin(), topA.end(), topB.begin(), topB.end(), std::back_inserter(common));
+  return static_cast<double>(common.size()) / static_cast<double>(topA.size());
+}
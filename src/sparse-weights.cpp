@@ -0,0 +1,110 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+
+#include "sparse-weights.h"
+
+namespace {
+
+size_t nextPowerOf2(size_t n) {
+  size_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+
+unsigned log2(size_t powerOf2) {
+  unsigned log = 0;
+  while ((static_cast<size_t>(1) << log) < powerOf2) {
+    log++;
+  }
+  return log;
+}
+
+}  // namespace
+
+constexpr uint64_t SparseWeights::EMPTY;
+
+SparseWeights::SparseWeights(rl::FLOAT defaultWeight, size_t capacity) :
+    _defaultWeight(defaultWeight),
+    _slotCount(0),
+    _shift(64),
+    _size(0) {
+  this->rehash(nextPowerOf2(std::max<size_t>(16, capacity * 2)));
+}
+
+void SparseWeights::add(uint64_t key, rl::FLOAT increment) {
+  size_t mask = this->_slotCount - 1;
+  size_t slot = this->findSlot(key);
+  while (true) {
+    uint64_t slotKey = this->_keys[slot].load(std::memory_order_relaxed);
+    if (slotKey == key) {
+      auto &value = this->_values[slot];
+      value.store(value.load(std::memory_order_relaxed) + increment, std::memory_order_relaxed);
+      return;
+    }
+
+    // Claim the empty slot. Nobody reads this key meanwhile, so the value can follow
+    // the key. If another thread claimed the slot first, look at it again.
+    uint64_t expected = EMPTY;
+    if (slotKey == EMPTY) {
+      if (this->_keys[slot].compare_exchange_strong(expected, key, std::memory_order_relaxed)) {
+        this->_values[slot].store(this->_defaultWeight + increment, std::memory_order_relaxed);
+        this->_size.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      continue;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+void SparseWeights::set(uint64_t key, rl::FLOAT weight) {
+  this->reserve(1);
+  size_t slot = this->findSlot(key);
+  if (this->_keys[slot].load(std::memory_order_relaxed) == EMPTY) {
+    this->_keys[slot].store(key, std::memory_order_relaxed);
+    this->_size.fetch_add(1, std::memory_order_relaxed);
+  }
+  this->_values[slot].store(weight, std::memory_order_relaxed);
+}
+
+void SparseWeights::reserve(size_t count) {
+  size_t needed = (this->size() + count) * 2;
+  if (needed > this->_slotCount) {
+    this->rehash(nextPowerOf2(needed));
+  }
+}
+
+void SparseWeights::clear() {
+  for (size_t slot = 0; slot < this->_slotCount; slot++) {
+    this->_keys[slot].store(EMPTY, std::memory_order_relaxed);
+  }
+  this->_size.store(0, std::memory_order_relaxed);
+}
+
+void SparseWeights::rehash(size_t slotCount) {
+  std::unique_ptr<std::atomic<uint64_t>[]> oldKeys = std::move(this->_keys);
+  std::unique_ptr<std::atomic<rl::FLOAT>[]> oldValues = std::move(this->_values);
+  size_t oldSlotCount = this->_slotCount;
+
+  this->_slotCount = slotCount;
+  this->_shift = 64 - log2(slotCount);
+  this->_keys.reset(new std::atomic<uint64_t>[slotCount]);
+  this->_values.reset(new std::atomic<rl::FLOAT>[slotCount]);
+  for (size_t slot = 0; slot < slotCount; slot++) {
+    this->_keys[slot].store(EMPTY, std::memory_order_relaxed);
+  }
+
+  for (size_t slot = 0; slot < oldSlotCount; slot++) {
+    uint64_t key = oldKeys[slot].load(std::memory_order_relaxed);
+    if (key != EMPTY) {
+      size_t newSlot = this->findSlot(key);
+      this->_keys[newSlot].store(key, std::memory_order_relaxed);
+      this->_values[newSlot].store(oldValues[slot].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+  }
+}
@@ -0,0 +1,168 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <chrono>
+
+#include "task-scheduler.h"
+
+using clock_type = std::chrono::steady_clock;
+
+TaskScheduler::TaskScheduler(size_t workerCount) :
+    _generation(0),
+    _activeWorkers(0),
+    _stopping(false),
+    _task(nullptr),
+    _failed(false) {
+  workerCount = std::max<size_t>(1, workerCount);
+  for (size_t i = 0; i < workerCount; i++) {
+    this->_workers.emplace_back(new Worker());
+  }
+  for (size_t i = 0; i < workerCount; i++) {
+    this->_workers[i]->thread = std::thread(&TaskScheduler::run, this, i);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_stopping = true;
+  }
+  this->_jobStarted.notify_all();
+  for (auto& worker : this->_workers) {
+    worker->thread.join();
+  }
+}
+
+void TaskScheduler::parallelFor(size_t count, size_t grainSize, const RANGE_TASK& task) {
+  if (count == 0) {
+    return;
+  }
+  grainSize = std::max<size_t>(1, grainSize);
+
+  // Deal each worker a contiguous share of the chunks.
+  size_t chunkCount = (count + grainSize - 1) / grainSize;
+  size_t workerCount = this->_workers.size();
+  for (size_t w = 0; w < workerCount; w++) {
+    Worker& worker = *this->_workers[w];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.chunks.clear();
+    worker.front = 0;
+    for (size_t c = chunkCount * w / workerCount; c < chunkCount * (w + 1) / workerCount; c++) {
+      worker.chunks.push_back({c * grainSize, std::min(count, (c + 1) * grainSize)});
+    }
+    worker.jobBusySeconds = 0;
+  }
+
+  auto jobBegin = clock_type::now();
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_task = &task;
+    this->_error = nullptr;
+    this->_failed.store(false, std::memory_order_relaxed);
+    this->_activeWorkers = workerCount;
+    this->_generation++;
+    this->_jobStarted.notify_all();
+
+    this->_jobFinished.wait(lock, [this]() { return this->_activeWorkers == 0; });
+    this->_task = nullptr;
+    error = this->_error;
+  }
+  double jobSeconds = std::chrono::duration<double>(clock_type::now() - jobBegin).count();
+
+  for (auto& worker : this->_workers) {
+    worker->stats.busySeconds += worker->jobBusySeconds;
+    worker->stats.idleSeconds += std::max(0.0, jobSeconds - worker->jobBusySeconds);
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+size_t TaskScheduler::getGrainSize(size_t count) const {
+  return std::max<size_t>(1, count / (this->_workers.size() * 16));
+}
+
+vector<TaskScheduler::WorkerStats> TaskScheduler::getStats() const {
+  vector<WorkerStats> stats;
+  for (auto& worker : this->_workers) {
+    stats.push_back(worker->stats);
+  }
+  return stats;
+}
+
+void TaskScheduler::run(size_t w) {
+  Worker& worker = *this->_workers[w];
+  size_t generation = 0;
+  while (true) {
+    const RANGE_TASK* task;
+    {
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_jobStarted.wait(lock, [this, generation]() {
+        return this->_stopping || this->_generation != generation;
+      });
+      if (this->_stopping) {
+        return;
+      }
+      generation = this->_generation;
+      task = this->_task;
+    }
+
+    Chunk chunk;
+    bool stolen;
+    while (this->takeChunk(w, chunk, stolen)) {
+      if (this->_failed.load(std::memory_order_relaxed)) {
+        continue;  // Drain.
+      }
+
+      auto begin = clock_type::now();
+      try {
+        (*task)(chunk.begin, chunk.end);
+      } catch(...) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (!this->_error) {
+          this->_error = std::current_exception();
+        }
+        this->_failed.store(true, std::memory_order_relaxed);
+      }
+      worker.jobBusySeconds += std::chrono::duration<double>(clock_type::now() - begin).count();
+      worker.stats.taskCount++;
+      worker.stats.stolenCount += stolen ? 1 : 0;
+    }
+
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (--this->_activeWorkers == 0) {
+      this->_jobFinished.notify_one();
+    }
+  }
+}
+
+bool TaskScheduler::takeChunk(size_t w, Chunk& chunk, bool& stolen) {
+  {
+    Worker& worker = *this->_workers[w];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.front < worker.chunks.size()) {
+      chunk = worker.chunks[worker.front++];
+      stolen = false;
+      return true;
+    }
+  }
+
+  // No new chunks are added during a job, so once every deque was seen empty
+  // there is nothing left to take.
+  size_t workerCount = this->_workers.size();
+  for (size_t i = 1; i < workerCount; i++) {
+    Worker& victim = *this->_workers[(w + i) % workerCount];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.front < victim.chunks.size()) {
+      chunk = victim.chunks.back();
+      victim.chunks.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
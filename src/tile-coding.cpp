@@ -0,0 +1,85 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "tile-coding.h"
+
+namespace app {
+
+size_t getMetricDimension(const std::vector<std::shared_ptr<Metric>> &metrics) {
+  size_t metricDimension = 1;
+  for (const auto &metric : metrics) {
+    metricDimension = std::max(metricDimension, metric->getMetricIndex() + 1);
+  }
+  return metricDimension;
+}
+
+namespace {
+
+size_t getExpectedTiles(size_t metricDimension, size_t tilesPerMetric) {
+  return TILING_COUNT * metricDimension * std::max<size_t>(1, tilesPerMetric);
+}
+
+}  // namespace
+
+size_t getTableSize(size_t metricDimension, size_t tilesPerMetric) {
+  size_t expectedTiles = getExpectedTiles(metricDimension, tilesPerMetric);
+  size_t tableSize = 1;
+  while (tableSize < expectedTiles * 2) {
+    tableSize <<= 1;
+  }
+  return tableSize;
+}
+
+size_t getSparseCapacity(size_t metricDimension, size_t tableSize) {
+  return std::min(getExpectedTiles(metricDimension, SPARSE_TILES_PER_METRIC), tableSize);
+}
+
+TileCoder parseTileCoder(const std::string &name) {
+  if (name == "pattern") {
+    return TileCoder::PATTERN;
+  } else if (name == "murmur") {
+    return TileCoder::MURMUR;
+  }
+
+  throw std::domain_error("Unknown tile coder \"" + name + "\".");
+}
+
+std::string getTileCoderName(TileCoder tileCoder) {
+  switch (tileCoder) {
+    case TileCoder::MURMUR:
+      return "murmur";
+    case TileCoder::PATTERN:
+    default:
+      return "pattern";
+  }
+}
+
+TileCoder getTileCoder(const rl::coding::TileCode &tileCode) {
+  return dynamic_cast<const PATTERN_TILE_CODE*>(&tileCode) != nullptr ? TileCoder::PATTERN : TileCoder::MURMUR;
+}
+
+std::unique_ptr<rl::coding::TileCode> createTileCode(size_t metricDimension, size_t tableSize, TileCoder tileCoder) {
+  if (tileCoder == TileCoder::PATTERN) {
+    return std::unique_ptr<rl::coding::TileCode>(new PATTERN_TILE_CODE(metricDimension, tableSize));
+  }
+
+  vector<rl::coding::DimensionInfo<rl::FLOAT>> dimensionalInfoVector;
+  for (size_t i = 0; i < app::PATTERN_SIZE; i++) {
+    dimensionalInfoVector.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 1.0F, 10));  // y1 to y10.
+  }
+
+  // Metrics that will lead to goalState, one tile per metric index.
+  auto lastMetricIndex = static_cast<rl::FLOAT>(metricDimension - 1);
+  dimensionalInfoVector.push_back(
+      rl::coding::DimensionInfo<rl::FLOAT>(0.0F, lastMetricIndex, metricDimension, 0.0F));
+  dimensionalInfoVector.push_back(rl::coding::DimensionInfo<rl::FLOAT>(0.0F, 0.0F, 1, 0.0F));  // The action.
+
+  return std::unique_ptr<rl::coding::TileCode>(
+      new rl::coding::TileCodeMurMur(dimensionalInfoVector, TILING_COUNT, tableSize));
+}
+
+}  // namespace app
@@ -0,0 +1,237 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "train-checkpoint.h"
+#include "half-float.h"
+#include "q-model.h"
+
+namespace {
+const char MAGIC[8] = { 'A', 'E', 'R', 'L', 'C', 'K', 'P', '\0' };
+}  // namespace
+
+void TrainCheckpoint::capture(const QModel &model) {
+  this->_modelSize = model.getSize();
+  this->_numTilings = model.getNumTilings();
+  this->_tileCoder = model.getTileCoder();
+  this->_initialWeight = model.getInitialWeight();
+  this->_weightIndices.clear();
+  this->_weightValues.clear();
+  model.copyTable(this->_table, this->_halfTable);
+  if (model.isSparse()) {
+    model.getChangedWeights(this->_weightIndices, this->_weightValues);
+  }
+}
+
+template <class F>
+void TrainCheckpoint::forEachChangedWeight(const F &f) const {
+  // Same as QModel::getChangedWeights.
+  if (!this->_table.empty()) {
+    for (size_t i = 0; i < this->_table.size(); i++) {
+      if (this->_table[i] != this->_initialWeight) {
+        f(i, this->_table[i]);
+      }
+    }
+  } else if (!this->_halfTable.empty()) {
+    for (size_t i = 0; i < this->_halfTable.size(); i++) {
+      float weight = this->_initialWeight + app::fromHalf(this->_halfTable[i]);
+      if (weight != this->_initialWeight) {
+        f(i, weight);
+      }
+    }
+  } else {
+    for (size_t w = 0; w < this->_weightIndices.size(); w++) {
+      f(this->_weightIndices[w], this->_weightValues[w]);
+    }
+  }
+}
+
+void TrainCheckpoint::restore(QModel &model) const {
+  if (model.getSize() != this->_modelSize || model.getNumTilings() != this->_numTilings) {
+    throw std::runtime_error("The checkpoint was written for a differently sized model.");
+  }
+  if (model.getTileCoder() != this->_tileCoder) {
+    throw std::runtime_error("The checkpoint was written with the \"" + app::getTileCoderName(this->_tileCoder) +
+                             "\" tile coder, not \"" + app::getTileCoderName(model.getTileCoder()) + "\".");
+  }
+
+  model.reset();
+  model.reserveIncrements(this->_weightIndices.size());
+  this->forEachChangedWeight([&model](uint64_t index, float weight) {
+    model.setWeight(index, weight);
+  });
+}
+
+void TrainCheckpoint::write(const string &fileName) const {
+  vector<uint64_t> weightIndices;
+  vector<float> weightValues;
+  this->forEachChangedWeight([&](uint64_t index, float weight) {
+    weightIndices.push_back(index);
+    weightValues.push_back(weight);
+  });
+
+  string temporaryFileName = fileName + ".tmp";
+  {
+    std::ofstream stream(temporaryFileName, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+      throw std::runtime_error("Problem opening " + temporaryFileName + " for writing.");
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sampler = static_cast<uint32_t>(this->sampler);
+    header.seed = this->seed;
+    header.iterationCount = this->iterationCount;
+    header.iterationsDone = this->iterationsDone;
+    header.round = this->round;
+    header.metricCount = this->metricCount;
+    header.modelSize = this->_modelSize;
+    header.numTilings = this->_numTilings;
+    header.tileCoder = static_cast<uint32_t>(this->_tileCoder);
+    header.activeCount = this->activeMetrics.size();
+    header.weightCount = weightIndices.size();
+
+    vector<uint64_t> activeMetrics(this->activeMetrics.begin(), this->activeMetrics.end());
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(activeMetrics.data()), sizeof(uint64_t) * activeMetrics.size());
+    stream.write(reinterpret_cast<const char*>(weightIndices.data()), sizeof(uint64_t) * weightIndices.size());
+    stream.write(reinterpret_cast<const char*>(weightValues.data()), sizeof(float) * weightValues.size());
+    if (!stream.flush()) {
+      throw std::runtime_error("Problem writing " + temporaryFileName + ".");
+    }
+  }
+
+  if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+    throw std::runtime_error("Problem renaming " + temporaryFileName + " to " + fileName + ".");
+  }
+}
+
+TrainCheckpoint TrainCheckpoint::read(const string &fileName) {
+  std::ifstream stream(fileName, std::ios::binary);
+  if (!stream.is_open()) {
+    throw std::runtime_error("Problem opening " + fileName + ".");
+  }
+
+  Header header;
+  if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error(fileName + " is not a training checkpoint.");
+  }
+  if (header.version < VERSION) {
+    // Before version 3, checkpoints didn't say which tile coder their weights were hashed by.
+    throw std::runtime_error(fileName + " was written by an older version (" + std::to_string(header.version) +
+                             ") without its tile coder, start training again.");
+  }
+  if (header.version != VERSION) {
+    throw std::runtime_error(fileName + " was written by an incompatible version.");
+  }
+
+  TrainCheckpoint checkpoint;
+  checkpoint.seed = header.seed;
+  checkpoint.sampler = static_cast<app::Sampler>(header.sampler);
+  checkpoint.iterationCount = header.iterationCount;
+  checkpoint.iterationsDone = header.iterationsDone;
+  checkpoint.round = header.round;
+  checkpoint.metricCount = header.metricCount;
+  checkpoint._modelSize = header.modelSize;
+  checkpoint._numTilings = header.numTilings;
+  checkpoint._tileCoder = static_cast<app::TileCoder>(header.tileCoder);
+
+  if (header.activeCount > header.metricCount || header.weightCount > header.modelSize ||
+      header.tileCoder > static_cast<uint32_t>(app::TileCoder::MURMUR)) {
+    throw std::runtime_error(fileName + " is truncated or corrupted.");
+  }
+  vector<uint64_t> activeMetrics(header.activeCount);
+  checkpoint._weightIndices.resize(header.weightCount);
+  checkpoint._weightValues.resize(header.weightCount);
+  stream.read(reinterpret_cast<char*>(activeMetrics.data()), sizeof(uint64_t) * activeMetrics.size());
+  stream.read(reinterpret_cast<char*>(checkpoint._weightIndices.data()),
+              sizeof(uint64_t) * checkpoint._weightIndices.size());
+  stream.read(reinterpret_cast<char*>(checkpoint._weightValues.data()),
+              sizeof(float) * checkpoint._weightValues.size());
+  if (!stream) {
+    throw std::runtime_error(fileName + " is truncated or corrupted.");
+  }
+
+  for (auto m : activeMetrics) {
+    if (m >= header.metricCount) {
+      throw std::runtime_error(fileName + " is truncated or corrupted.");
+    }
+  }
+  for (auto w : checkpoint._weightIndices) {
+    if (w >= header.modelSize) {
+      throw std::runtime_error(fileName + " is truncated or corrupted.");
+    }
+  }
+  checkpoint.activeMetrics.assign(activeMetrics.begin(), activeMetrics.end());
+
+  return checkpoint;
+}
+
+CheckpointWriter::CheckpointWriter(const string &fileName) :
+    _fileName(fileName),
+    _writing(false),
+    _stopping(false) {
+  this->_thread = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_stopping = true;
+  }
+  this->_changed.notify_all();
+  this->_thread.join();
+}
+
+void CheckpointWriter::write(TrainCheckpoint checkpoint) {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (this->_error) {
+      std::rethrow_exception(this->_error);
+    }
+    this->_pending.reset(new TrainCheckpoint(std::move(checkpoint)));
+  }
+  this->_changed.notify_all();
+}
+
+void CheckpointWriter::wait() {
+  std::unique_lock<std::mutex> lock(this->_mutex);
+  this->_changed.wait(lock, [this] { return !this->_pending && !this->_writing; });
+  if (this->_error) {
+    std::rethrow_exception(this->_error);
+  }
+}
+
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(this->_mutex);
+  while (true) {
+    this->_changed.wait(lock, [this] { return this->_pending || this->_stopping; });
+    if (!this->_pending) {
+      return;
+    }
+
+    std::unique_ptr<TrainCheckpoint> checkpoint = std::move(this->_pending);
+    this->_writing = true;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      checkpoint->write(this->_fileName);
+    } catch(...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    this->_writing = false;
+    if (error) {
+      this->_error = error;
+    }
+    this->_changed.notify_all();
+  }
+}
@@ -0,0 +1,129 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <stdexcept>
+
+#include "window-sampler.h"
+
+namespace app {
+
+Sampler parseSampler(const std::string &name) {
+  if (name == "uniform") {
+    return Sampler::UNIFORM;
+  } else if (name == "stratified") {
+    return Sampler::STRATIFIED;
+  } else if (name == "sobol") {
+    return Sampler::SOBOL;
+  }
+
+  throw std::domain_error("Unknown sampler \"" + name + "\".");
+}
+
+std::string getSamplerName(Sampler sampler) {
+  switch (sampler) {
+    case Sampler::STRATIFIED:
+      return "stratified";
+    case Sampler::SOBOL:
+      return "sobol";
+    case Sampler::UNIFORM:
+    default:
+      return "uniform";
+  }
+}
+
+}  // namespace app
+
+namespace {
+
+uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+uint64_t reverseBits(uint64_t x) {
+  x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+  x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+  x = ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((x & 0x0f0f0f0f0f0f0f0fULL) << 4);
+  x = ((x >> 8) & 0x00ff00ff00ff00ffULL) | ((x & 0x00ff00ff00ff00ffULL) << 8);
+  x = ((x >> 16) & 0x0000ffff0000ffffULL) | ((x & 0x0000ffff0000ffffULL) << 16);
+  return (x >> 32) | (x << 32);
+}
+
+// Counters of the random numbers the sampler draws besides the per iteration ones.
+enum : uint64_t {
+  STRIDE_OFFSET_COUNTER = ~0ULL,
+  SOBOL_SHIFT_COUNTER = ~0ULL - 1
+};
+
+}  // namespace
+
+uint64_t WindowSampler::scale(uint64_t fraction, uint64_t range) {
+  uint64_t high = fraction >> 32;
+  uint64_t low = fraction & 0xffffffffULL;
+  uint64_t rangeHigh = range >> 32;
+  uint64_t rangeLow = range & 0xffffffffULL;
+
+  // 128 bit product fraction * range, keeping the upper 64 bits.
+  uint64_t lowLow = low * rangeLow;
+  uint64_t highLow = high * rangeLow;
+  uint64_t lowHigh = low * rangeHigh;
+  uint64_t middle = (lowLow >> 32) + (highLow & 0xffffffffULL) + (lowHigh & 0xffffffffULL);
+  return high * rangeHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+}
+
+WindowSampler::WindowSampler(app::Sampler sampler,
+                             uint64_t seed,
+                             size_t iterationCount,
+                             app::time timeBegin,
+                             app::time timeEnd) :
+    _sampler(sampler),
+    _random(seed),
+    _iterationCount(iterationCount == 0 ? 1 : iterationCount),
+    _timeBegin(timeBegin),
+    _range(static_cast<uint64_t>(timeEnd - timeBegin) + 1),
+    _strideStep(1),
+    _strideOffset(0),
+    _sobolShift(this->_random.get(SOBOL_SHIFT_COUNTER)) {
+  // Visiting stratum (i * step + offset) % n, with step coprime to n, visits every
+  // stratum once. With step close to n / golden ratio, the strata visited by any
+  // prefix of the iterations are spread over the whole range (a Weyl sequence).
+  uint64_t n = this->_iterationCount;
+  this->_strideOffset = this->_random.get(STRIDE_OFFSET_COUNTER) % n;
+  if (n > 2) {
+    uint64_t step = static_cast<uint64_t>(n * 0.6180339887498949);
+    while (gcd(step, n) != 1) {
+      step++;
+    }
+    this->_strideStep = step % n;
+  }
+}
+
+app::time WindowSampler::getTimeBegin(size_t iteration) const {
+  uint64_t offset;
+  switch (this->_sampler) {
+    case app::Sampler::STRATIFIED: {
+      uint64_t n = this->_iterationCount;
+      uint64_t stratum = (iteration % n * this->_strideStep + this->_strideOffset) % n;
+      // floor(range * stratum / n), without overflowing range * stratum.
+      uint64_t stratumBegin = this->_range / n * stratum + (this->_range % n) * stratum / n;
+      uint64_t stratumEnd = this->_range / n * (stratum + 1) + (this->_range % n) * (stratum + 1) / n;
+      uint64_t width = stratumEnd - stratumBegin;
+      offset = stratumBegin + (width == 0 ? 0 : this->_random.get(iteration) % width);
+      break;
+    }
+    case app::Sampler::SOBOL:
+      offset = WindowSampler::scale(reverseBits(static_cast<uint64_t>(iteration)) ^ this->_sobolShift, this->_range);
+      break;
+    case app::Sampler::UNIFORM:
+    default:
+      offset = this->_random.get(iteration) % this->_range;
+      break;
+  }
+
+  return this->_timeBegin + static_cast<app::time>(offset);
+}
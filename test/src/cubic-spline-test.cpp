@@ -0,0 +1,82 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "catch.hpp"
+#include "cubic-spline.h"
+#include "spline.h"
+
+using std::vector;
+
+namespace {
+
+// Irregularly spaced datapoints, so no fixed step shortcut applies.
+MetricData createData(size_t pointCount) {
+  vector<app::time> times(pointCount);
+  vector<app::value> values(pointCount);
+  for (size_t i = 0; i < pointCount; i++) {
+    times[i] = 1000000 + 60 * i + (i % 7);
+    values[i] = std::sin(i * 0.1) * 100 + (i % 13);
+  }
+  return MetricData(std::move(times), std::move(values));
+}
+
+// tk::spline, as Metric::getPattern used to fit it, through data[begin, end).
+vector<double> interpolateTk(const MetricData& data,
+                             size_t begin,
+                             size_t end,
+                             double timeBegin,
+                             double increment,
+                             size_t count) {
+  vector<double> x;
+  vector<double> y;
+  for (size_t i = begin; i < end; i++) {
+    x.push_back(static_cast<double>(data.timeAt(i)));
+    y.push_back(data.valueAt(i));
+  }
+  tk::spline spline;
+  spline.set_points(x, y);
+
+  vector<double> out(count);
+  for (size_t k = 0; k < count; k++) {
+    out[k] = spline(timeBegin + increment * k);
+  }
+  return out;
+}
+
+}  // namespace
+
+SCENARIO("CubicSpline is the same natural cubic spline as tk::spline.") {
+  for (size_t pointCount : {3, 4, 10, 57, 500}) {
+    GIVEN(std::to_string(pointCount) + " datapoints.") {
+      MetricData data = createData(pointCount);
+
+      THEN("Both give the same values inside, before and after the fitted range.") {
+        // The whole series, and a range in its middle.
+        vector<std::pair<size_t, size_t>> ranges({{0, pointCount}});
+        if (pointCount >= 10) {
+          ranges.push_back({pointCount / 5, pointCount - pointCount / 5});
+        }
+        for (const auto& range : ranges) {
+          double rangeBegin = static_cast<double>(data.timeAt(range.first));
+          double rangeEnd = static_cast<double>(data.timeAt(range.second - 1));
+          // Starts 10% before the range and ends 10% after it, extrapolating linearly.
+          size_t count = 97;
+          double timeBegin = rangeBegin - (rangeEnd - rangeBegin) * 0.1;
+          double increment = (rangeEnd - rangeBegin) * 1.2 / count;
+
+          auto expected = interpolateTk(data, range.first, range.second, timeBegin, increment, count);
+          vector<double> actual(count);
+          CubicSpline::interpolate(data, range.first, range.second, timeBegin, increment, count, actual.data());
+          for (size_t k = 0; k < count; k++) {
+            REQUIRE(std::abs(actual[k] - expected[k]) <= 1e-6);
+          }
+        }
+      }
+    }
+  }
+}
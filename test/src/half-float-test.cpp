@@ -0,0 +1,102 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "catch.hpp"
+#include "half-float.h"
+
+namespace {
+
+float fromBits(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint32_t toBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+bool isNaN(uint16_t half) {
+  return (half & 0x7c00) == 0x7c00 && (half & 0x03ff) != 0;
+}
+
+}  // namespace
+
+SCENARIO("Half precision floats convert to float and back.") {
+  GIVEN("Every one of the 65536 halves.") {
+    THEN("fromHalf then toHalf gives the same half, NaNs stay NaNs of the same sign.") {
+      for (uint32_t h = 0; h <= 0xffff; h++) {
+        uint16_t half = static_cast<uint16_t>(h);
+        for (auto roundTrip : {app::toHalf(app::fromHalf(half)),
+                               app::toHalfSoftware(app::fromHalfSoftware(half))}) {
+          if (isNaN(half)) {
+            REQUIRE(isNaN(roundTrip));
+            REQUIRE((roundTrip & 0x8000) == (half & 0x8000));
+          } else {
+            REQUIRE(roundTrip == half);
+          }
+        }
+      }
+    }
+
+    THEN("The software fromHalf gives the same floats as fromHalf.") {
+      for (uint32_t h = 0; h <= 0xffff; h++) {
+        uint16_t half = static_cast<uint16_t>(h);
+        if (isNaN(half)) {
+          REQUIRE(std::isnan(app::fromHalfSoftware(half)));
+        } else {
+          REQUIRE(toBits(app::fromHalfSoftware(half)) == toBits(app::fromHalf(half)));
+        }
+      }
+    }
+  }
+
+  GIVEN("The floats where the software toHalf changes branch, and their neighbours.") {
+    // Rounds past 65504, at most half the smallest subnormal, the smallest normal half.
+    const uint32_t boundaries[] = { 0x477ff000, 0x33000000, 0x38800000 };
+
+    THEN("They round to the known halves, ties to even.") {
+      REQUIRE(app::toHalfSoftware(fromBits(0x477ff000)) == 0x7c00);  // 65520, tie to infinity.
+      REQUIRE(app::toHalfSoftware(fromBits(0x477fefff)) == 0x7bff);  // 65504.
+      REQUIRE(app::toHalfSoftware(fromBits(0x33000000)) == 0x0000);  // 2^-25, tie to 0.
+      REQUIRE(app::toHalfSoftware(fromBits(0x33000001)) == 0x0001);  // 2^-24.
+      REQUIRE(app::toHalfSoftware(fromBits(0x38800000)) == 0x0400);  // 2^-14.
+      REQUIRE(app::toHalfSoftware(fromBits(0x387fffff)) == 0x0400);
+      REQUIRE(app::toHalfSoftware(-fromBits(0x38800000)) == 0x8400);
+    }
+
+#if defined(__F16C__)
+    auto hardwareToHalf = [](float value) {
+      return static_cast<uint16_t>(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+    };
+
+    THEN("The software toHalf agrees with _cvtss_sh around them.") {
+      for (uint32_t boundary : boundaries) {
+        for (uint32_t bits = boundary - 4096; bits <= boundary + 4096; bits++) {
+          REQUIRE(app::toHalfSoftware(fromBits(bits)) == hardwareToHalf(fromBits(bits)));
+          REQUIRE(app::toHalfSoftware(fromBits(bits | 0x80000000)) == hardwareToHalf(fromBits(bits | 0x80000000)));
+        }
+      }
+    }
+
+    THEN("The software toHalf agrees with _cvtss_sh over the whole float range.") {
+      // A stride coprime with 2^13 reaches every rounding remainder.
+      for (uint64_t bits = 0; bits < 0x7f800000; bits += 9973) {
+        float value = fromBits(static_cast<uint32_t>(bits));
+        REQUIRE(app::toHalfSoftware(value) == hardwareToHalf(value));
+      }
+      REQUIRE(app::toHalfSoftware(INFINITY) == hardwareToHalf(INFINITY));
+      REQUIRE(app::toHalfSoftware(-INFINITY) == hardwareToHalf(-INFINITY));
+    }
+#else
+    WARN("Not compiled for F16C, the software conversion is only checked against known answers.");
+#endif
+  }
+}
@@ -0,0 +1,114 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "catch.hpp"
+#include "metric-data.h"
+
+using std::vector;
+
+namespace {
+
+MetricData createData(const vector<app::time>& times) {
+  vector<app::time> timeColumn(times);
+  vector<app::value> values(times.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<app::value>(i);
+  }
+  return MetricData(std::move(timeColumn), std::move(values));
+}
+
+// The lookups of data, checked against std::lower_bound and std::upper_bound
+// over times for every time around them.
+void requireLookups(const MetricData& data, const vector<app::time>& times) {
+  app::time first = times.empty() ? 100 : times.front();
+  app::time last = times.empty() ? 100 : times.back();
+  for (app::time t = first - std::min<app::time>(first, 10); t <= last + 10; t++) {
+    size_t lower = std::lower_bound(times.begin(), times.end(), t) - times.begin();
+    size_t upper = std::upper_bound(times.begin(), times.end(), t) - times.begin();
+    REQUIRE(data.lowerBound(t) == lower);
+    REQUIRE(data.upperBound(t) == upper);
+
+    // Galloping from every index at or before the result.
+    for (size_t from = 0; from <= lower; from++) {
+      REQUIRE(data.lowerBoundFrom(t, from) == lower);
+    }
+    for (size_t from = 0; from <= upper; from++) {
+      REQUIRE(data.upperBoundFrom(t, from) == upper);
+    }
+  }
+}
+
+}  // namespace
+
+SCENARIO("MetricData maps times to indices.") {
+  GIVEN("An empty series.") {
+    vector<app::time> times;
+    MetricData data = createData(times);
+
+    THEN("Every time maps to index 0.") {
+      REQUIRE(data.empty());
+      REQUIRE_FALSE(data.isFixedStep());
+      requireLookups(data, times);
+    }
+  }
+
+  GIVEN("A single datapoint.") {
+    vector<app::time> times({1000});
+    MetricData data = createData(times);
+
+    THEN("It has no step, and times before, at and after it are located.") {
+      REQUIRE_FALSE(data.isFixedStep());
+      requireLookups(data, times);
+    }
+  }
+
+  GIVEN("A series sampled at a constant step.") {
+    vector<app::time> times({1000, 1060, 1120, 1180, 1240, 1300});
+    MetricData data = createData(times);
+
+    THEN("Its timestamp column is dropped, and lookups match a binary search.") {
+      REQUIRE(data.isFixedStep());
+      REQUIRE(data.getStep() == 60);
+      REQUIRE(data.times() == nullptr);
+      for (size_t i = 0; i < times.size(); i++) {
+        REQUIRE(data.timeAt(i) == times[i]);
+      }
+      requireLookups(data, times);
+    }
+  }
+
+  GIVEN("Irregular series, with duplicate times and gaps.") {
+    for (const auto& times : vector<vector<app::time>>({
+        {1000, 1001},
+        {1000, 1000, 1000},
+        {1000, 1003, 1003, 1004, 1020, 1021, 1021, 1050},
+        {1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007, 1008, 1009, 1010, 1011, 1012, 1013, 1014, 1015, 1016,
+         1040}})) {
+      MetricData data = createData(times);
+
+      THEN("Lookups match a binary search, " + std::to_string(times.size()) + " datapoints.") {
+        REQUIRE(data.isFixedStep() == (times.size() == 2));
+        requireLookups(data, times);
+      }
+    }
+  }
+
+  GIVEN("Series that are almost sampled at a constant step.") {
+    THEN("Only an exactly constant, positive step is detected.") {
+      REQUIRE(MetricData::detectStep(vector<app::time>({10, 20}).data(), 2) == 10);
+      REQUIRE(MetricData::detectStep(vector<app::time>({10, 20, 30, 40}).data(), 4) == 10);
+      // The last gap differs.
+      REQUIRE(MetricData::detectStep(vector<app::time>({10, 20, 30, 41}).data(), 4) == 0);
+      // The first gap differs.
+      REQUIRE(MetricData::detectStep(vector<app::time>({10, 21, 31, 41}).data(), 4) == 0);
+      // No step between equal times.
+      REQUIRE(MetricData::detectStep(vector<app::time>({10, 10, 10}).data(), 3) == 0);
+      REQUIRE(MetricData::detectStep(vector<app::time>({10}).data(), 1) == 0);
+      REQUIRE(MetricData::detectStep(nullptr, 0) == 0);
+    }
+  }
+}
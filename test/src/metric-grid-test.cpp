@@ -0,0 +1,114 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch.hpp"
+#include "interpolation.h"
+#include "metric.h"
+#include "metric-grid.h"
+#include "plot-pattern.h"
+
+using std::vector;
+
+namespace {
+
+const app::time TIME_BEGIN = 1474100000;
+
+std::shared_ptr<Metric> createMetric(const std::string& name,
+                                     vector<app::time> times,
+                                     vector<app::value> values) {
+  return std::make_shared<Metric>(name, MetricData(std::move(times), std::move(values)), 0);
+}
+
+// Irregular datapoints with a sparse stretch, so some windows have too few.
+std::shared_ptr<Metric> createIrregularMetric() {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<app::time> gap(1, 90);
+  vector<app::time> times;
+  vector<app::value> values;
+  app::time t = TIME_BEGIN;
+  for (size_t i = 0; i < 200; i++) {
+    t += i >= 100 && i < 110 ? 3000 : gap(generator);
+    times.push_back(t);
+    values.push_back(std::sin(i * 0.3) * 10 + i % 5);
+  }
+  return createMetric("metric.irregular", std::move(times), std::move(values));
+}
+
+}  // namespace
+
+SCENARIO("MetricGrid resamples metrics onto a shared time grid.") {
+  GIVEN("Two metrics, one covering only part of the grid.") {
+    auto first = createMetric("metric.first", {1000, 1100, 1200}, {0, 10, 40});
+    auto second = createMetric("metric.second", {1100, 1150}, {-2, 2});
+    MetricGrid grid({first, second}, 900, 1300, 50);
+
+    THEN("Rows are linearly interpolated, and clamped to the first and last value.") {
+      REQUIRE(grid.getRowCount() == 2);
+      REQUIRE(grid.getColumnCount() == 10);
+      REQUIRE(grid.getTimeBegin() == 900);
+      REQUIRE(grid.getStep() == 50);
+
+      vector<double> expectedFirst({0, 0, 0, 5, 10, 25, 40, 40, 40, 40});
+      vector<double> expectedSecond({-2, -2, -2, -2, -2, 2, 2, 2, 2, 2});
+      for (size_t column = 0; column < grid.getColumnCount(); column++) {
+        REQUIRE(grid.getRow(0)[column] == expectedFirst[column]);
+        REQUIRE(grid.getRow(1)[column] == expectedSecond[column]);
+      }
+    }
+
+    THEN("Rows are found by metric, and unknown metrics are refused.") {
+      REQUIRE(grid.findRow(first) == 0);
+      REQUIRE(grid.findRow(second) == 1);
+      REQUIRE_THROWS_AS(grid.findRow(createMetric("metric.first", {1000}, {0})), std::invalid_argument);
+    }
+  }
+
+  GIVEN("Grid dimensions over the size limit.") {
+    auto metric = createMetric("metric.0", {1000, 1100, 1200}, {0, 10, 40});
+    size_t size = MetricGrid::getSizeInBytes(1, 1000, 1000000, 1);
+
+    THEN("The grid is refused before allocating.") {
+      REQUIRE_THROWS_AS(MetricGrid({metric}, 1000, 1000000, 1, size - 1), std::length_error);
+      REQUIRE_NOTHROW(MetricGrid({metric}, 1000, 1000000, 1, size));
+      REQUIRE(MetricGrid::getSizeInBytes(2, 0, std::numeric_limits<app::time>::max() - 1, 1) ==
+          std::numeric_limits<size_t>::max());
+    }
+
+    THEN("A zero step or a reversed range is refused.") {
+      REQUIRE_THROWS_AS(MetricGrid({metric}, 1000, 2000, 0), std::invalid_argument);
+      REQUIRE_THROWS_AS(MetricGrid({metric}, 2000, 1000, 10), std::invalid_argument);
+    }
+  }
+
+  GIVEN("Windows sliding over and past a metric, some over its sparse stretch.") {
+    auto metric = createIrregularMetric();
+    MetricGrid grid({metric}, metric->getTimeBegin(), metric->getTimeEnd(), 10);
+
+    THEN("The grid rejects the same windows as Metric::tryGetPattern.") {
+      size_t statusCounts[static_cast<size_t>(app::PatternStatus::COUNT)] = {};
+      for (app::time duration : {120, 600, 2400}) {
+        for (app::time tBegin = TIME_BEGIN - 3000; tBegin < metric->getTimeEnd() + 3000; tBegin += 53) {
+          app::time tEnd = tBegin + duration;
+          PlotPattern<app::PATTERN_SIZE> pattern;
+          auto status = Metric::tryGetPattern<app::PATTERN_SIZE, LinearInterpolation>(metric, tBegin, tEnd, pattern);
+          PlotPattern<app::PATTERN_SIZE> gridPattern;
+          REQUIRE(grid.tryGetPattern<app::PATTERN_SIZE>(0, tBegin, tEnd, gridPattern) == status);
+          PatternFeatures<app::PATTERN_SIZE> features;
+          REQUIRE(grid.tryGetFeatures<app::PATTERN_SIZE>(0, tBegin, tEnd, features) == status);
+          statusCounts[static_cast<size_t>(status)]++;
+        }
+      }
+      for (size_t count : statusCounts) {
+        REQUIRE(count > 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,159 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "metric.h"
+#include "metric-store.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char* STORE_FILE = "metric-store-test.aem";
+const char* CORRUPT_FILE = "metric-store-test-corrupt.aem";
+
+vector<std::shared_ptr<Metric>> createMetrics() {
+  vector<std::shared_ptr<Metric>> metrics;
+  metrics.push_back(std::make_shared<Metric>(
+      "metric.irregular", MetricData(vector<app::time>({100, 130, 250, 260}), vector<app::value>({1.5, -2, 0.125, 7})), 0));
+  metrics.push_back(std::make_shared<Metric>(
+      "metric.fixed", MetricData(vector<app::time>({100, 160, 220, 280, 340}), vector<app::value>({1, 2, 3, 4, 5.5})), 1));
+  metrics.push_back(std::make_shared<Metric>(
+      "", MetricData(vector<app::time>(), vector<app::value>()), 2));
+  return metrics;
+}
+
+vector<char> readFile(const string& fileName) {
+  std::ifstream stream(fileName, std::ios::binary);
+  return vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const string& fileName, const vector<char>& bytes) {
+  std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+  stream.write(bytes.data(), bytes.size());
+}
+
+template <class T>
+void patch(vector<char>& bytes, size_t offset, T value) {
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+}  // namespace
+
+SCENARIO("MetricStore round trips metrics through its binary layout.") {
+  GIVEN("An irregular, a fixed step and an empty metric written to a store.") {
+    auto metrics = createMetrics();
+    REQUIRE_FALSE(metrics[0]->getData().isFixedStep());
+    REQUIRE(metrics[1]->getData().isFixedStep());
+    MetricStore::write(STORE_FILE, metrics);
+
+    WHEN("The store is opened.") {
+      REQUIRE(MetricStore::isMetricStore(STORE_FILE));
+      auto store = MetricStore::open(STORE_FILE);
+      auto loaded = store->getMetrics();
+
+      THEN("Every metric has the same name, index and datapoints.") {
+        REQUIRE(store->size() == metrics.size());
+        REQUIRE(loaded.size() == metrics.size());
+        for (size_t m = 0; m < metrics.size(); m++) {
+          const auto& expected = metrics[m]->getData();
+          const auto& data = loaded[m]->getData();
+          REQUIRE(loaded[m]->getMetricName() == metrics[m]->getMetricName());
+          REQUIRE(loaded[m]->getMetricIndex() == m);
+          REQUIRE(data.size() == expected.size());
+          REQUIRE(data.isFixedStep() == expected.isFixedStep());
+          for (size_t i = 0; i < data.size(); i++) {
+            REQUIRE(data.timeAt(i) == expected.timeAt(i));
+            REQUIRE(data.valueAt(i) == expected.valueAt(i));
+          }
+        }
+        REQUIRE(loaded[1]->getData().getStep() == 60);
+        REQUIRE(loaded[1]->getIndexAfter(200) == 2);
+        REQUIRE(loaded[0]->getIndexBefore(255) == 2);
+      }
+
+      THEN("The metrics keep the mapping alive after the store is released.") {
+        store.reset();
+        REQUIRE(loaded[0]->getData().valueAt(3) == 7);
+      }
+    }
+  }
+
+  GIVEN("A file that is not a store.") {
+    writeFile(CORRUPT_FILE, vector<char>(256, 'x'));
+
+    THEN("It is not recognized, and opening it throws.") {
+      REQUIRE_FALSE(MetricStore::isMetricStore(CORRUPT_FILE));
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+      REQUIRE_THROWS_AS(MetricStore::open("metric-store-test-missing.aem"), const std::runtime_error&);
+    }
+  }
+
+  GIVEN("A valid store's bytes.") {
+    MetricStore::write(STORE_FILE, createMetrics());
+    auto bytes = readFile(STORE_FILE);
+    MetricStore::Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    size_t entryOffset = header.indexOffset;
+
+    THEN("Every truncation is rejected.") {
+      for (size_t size = 0; size < bytes.size(); size += 8) {
+        writeFile(CORRUPT_FILE, vector<char>(bytes.begin(), bytes.begin() + size));
+        REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+      }
+    }
+
+    THEN("Another version or value size is rejected.") {
+      auto versioned = bytes;
+      patch<uint32_t>(versioned, offsetof(MetricStore::Header, version), MetricStore::VERSION + 1);
+      writeFile(CORRUPT_FILE, versioned);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto resized = bytes;
+      patch<uint32_t>(resized, offsetof(MetricStore::Header, valueSize), 4);
+      writeFile(CORRUPT_FILE, resized);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+    }
+
+    THEN("Counts and offsets that overflow past the checks are rejected.") {
+      // Wraps indexOffset + sizeof(IndexEntry) * metricCount around to indexOffset.
+      auto metricCount = bytes;
+      patch<uint64_t>(metricCount, offsetof(MetricStore::Header, metricCount), 1ULL << 63);
+      writeFile(CORRUPT_FILE, metricCount);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto pointCount = bytes;
+      patch<uint64_t>(pointCount, offsetof(MetricStore::Header, pointCount), 1ULL << 61);
+      writeFile(CORRUPT_FILE, pointCount);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      // nameOffset + nameLength wraps around to a small number.
+      auto name = bytes;
+      patch<uint64_t>(name, entryOffset + offsetof(MetricStore::IndexEntry, nameOffset), ~0ULL);
+      patch<uint64_t>(name, entryOffset + offsetof(MetricStore::IndexEntry, nameLength), 2);
+      writeFile(CORRUPT_FILE, name);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto firstValue = bytes;
+      patch<uint64_t>(firstValue, entryOffset + offsetof(MetricStore::IndexEntry, firstValue), ~0ULL - 1);
+      writeFile(CORRUPT_FILE, firstValue);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto firstTime = bytes;
+      patch<uint64_t>(firstTime, entryOffset + offsetof(MetricStore::IndexEntry, firstTime), 3);
+      writeFile(CORRUPT_FILE, firstTime);
+      REQUIRE_THROWS_AS(MetricStore::open(CORRUPT_FILE), const std::runtime_error&);
+    }
+  }
+}
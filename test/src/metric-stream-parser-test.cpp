@@ -0,0 +1,160 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "json.hpp"
+#include "metric-stream-parser.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct ParsedMetric {
+  string target;
+  bool hasTarget;
+  vector<app::time> times;
+  vector<app::value> values;
+};
+
+vector<ParsedMetric> parseAll(const string& json, size_t bufferSize = 1 << 16) {
+  std::istringstream stream(json);
+  MetricStreamParser parser(stream, bufferSize);
+  vector<ParsedMetric> metrics;
+  ParsedMetric metric;
+  while (parser.next(metric.target, metric.hasTarget, metric.times, metric.values)) {
+    metrics.push_back(metric);
+  }
+  return metrics;
+}
+
+}  // namespace
+
+SCENARIO("MetricStreamParser reads graphite's metric export.") {
+  GIVEN("Two metrics, with extra keys and whitespace.") {
+    string json =
+        "[ {\"target\": \"a.b\", \"tags\": {\"x\": [1, \"]}\"]}, \"datapoints\": [[1.5, 100], [null, 160],\n"
+        "  [-2e-1, 220]]},\n"
+        "  {\"datapoints\": [], \"target\": null, \"step\": 60} ]";
+
+    WHEN("It is parsed.") {
+      auto metrics = parseAll(json);
+
+      THEN("Every metric's columns are read, null values are 0.") {
+        REQUIRE(metrics.size() == 2);
+        REQUIRE(metrics[0].hasTarget);
+        REQUIRE(metrics[0].target == "a.b");
+        REQUIRE(metrics[0].times == vector<app::time>({100, 160, 220}));
+        REQUIRE(metrics[0].values == vector<app::value>({1.5, 0.0, -0.2}));
+
+        REQUIRE_FALSE(metrics[1].hasTarget);
+        REQUIRE(metrics[1].times.empty());
+        REQUIRE(metrics[1].values.empty());
+      }
+    }
+  }
+
+  GIVEN("A metric name with escapes.") {
+    string json = "[{\"target\": \"a\\\"b\\\\c\\/d\\n\\u0041\\u00e9\\u20ac\", \"datapoints\": [[1, 2]]}]";
+
+    WHEN("It is parsed.") {
+      auto metrics = parseAll(json);
+
+      THEN("The escapes are decoded, \\u as UTF-8.") {
+        REQUIRE(metrics.size() == 1);
+        REQUIRE(metrics[0].target == "a\"b\\c/d\nA\xC3\xA9\xE2\x82\xAC");
+      }
+    }
+  }
+
+  GIVEN("A metric name with a \\u escaped surrogate pair.") {
+    string json = "[{\"target\": \"a\\uD83D\\uDE00b\", \"datapoints\": [[1, 2]]}]";
+
+    WHEN("It is parsed.") {
+      auto metrics = parseAll(json);
+
+      THEN("The pair is decoded as one 4 byte UTF-8 code point, as nlohmann::json does.") {
+        REQUIRE(metrics.size() == 1);
+        REQUIRE(metrics[0].target == "a\xF0\x9F\x98\x80" "b");
+        REQUIRE(metrics[0].target == nlohmann::json::parse(json)[0]["target"].get<string>());
+      }
+    }
+  }
+
+  GIVEN("A metric whose tokens straddle the read buffer's refills.") {
+    string json =
+        "[{\"target\": \"servers.\\u0041pp.requests\", "
+        "\"datapoints\": [[12345.678901, 1474100100], [null, 1474100160], [-0.000125, 1474100220]]}]";
+
+    THEN("Every buffer size gives the same metric.") {
+      auto expected = parseAll(json);
+      REQUIRE(expected.size() == 1);
+      REQUIRE(expected[0].target == "servers.App.requests");
+      REQUIRE(expected[0].values == vector<app::value>({12345.678901, 0.0, -0.000125}));
+
+      // Small buffers split every number, literal and escape at some offset.
+      for (size_t bufferSize = 1; bufferSize <= 17; bufferSize++) {
+        auto metrics = parseAll(json, bufferSize);
+        REQUIRE(metrics.size() == 1);
+        REQUIRE(metrics[0].target == expected[0].target);
+        REQUIRE(metrics[0].times == expected[0].times);
+        REQUIRE(metrics[0].values == expected[0].values);
+      }
+    }
+  }
+
+  GIVEN("An empty array.") {
+    THEN("There are no metrics.") {
+      REQUIRE(parseAll(" [ ] ").empty());
+    }
+  }
+
+  GIVEN("Malformed exports.") {
+    THEN("Parsing throws std::domain_error.") {
+      REQUIRE_THROWS_AS(parseAll("{}"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"a\", \"datapoints\": [[1, 2]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"a\\q\"}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"\\u00zz\"}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"datapoints\": [[1, x]]}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"a\"} {\"target\": \"b\"}]"), const std::domain_error&);
+      // Unpaired surrogates.
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"\\uD83D\"}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"\\uD83Dx\"}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"\\uD83D\\u0041\"}]"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"\\uDE00\"}]"), const std::domain_error&);
+      // Trailing data after the array.
+      REQUIRE_THROWS_AS(parseAll("[] x"), const std::domain_error&);
+      REQUIRE_THROWS_AS(parseAll("[{\"target\": \"a\"}] ]"), const std::domain_error&);
+    }
+  }
+
+  GIVEN("The metrics fixture.") {
+    std::ifstream stream("data/metrics.json");
+    REQUIRE(stream.is_open());
+
+    WHEN("It is parsed with a buffer smaller than a datapoint.") {
+      MetricStreamParser parser(stream, 7);
+      vector<ParsedMetric> metrics;
+      ParsedMetric metric;
+      while (parser.next(metric.target, metric.hasTarget, metric.times, metric.values)) {
+        metrics.push_back(metric);
+      }
+
+      THEN("Every metric is read.") {
+        REQUIRE(metrics.size() == 3);
+        REQUIRE(metrics[0].target == "metric.regular");
+        REQUIRE(metrics[0].times.size() == 8);
+        REQUIRE(metrics[1].target == "metric.irregular");
+        REQUIRE(metrics[1].times == vector<app::time>({100, 130, 250, 260, 400, 410, 530}));
+        REQUIRE(metrics[2].target == "metric \"quoted\"");
+        REQUIRE(metrics[2].values == vector<app::value>({0.25, 0.0, 0.75, 1.0, 0.5}));
+      }
+    }
+  }
+}
@@ -0,0 +1,102 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "catch.hpp"
+#include "interpolation.h"
+#include "metric.h"
+#include "plot-pattern.h"
+
+using std::vector;
+
+namespace {
+
+const app::time TIME_BEGIN = 1474100000;
+
+// Irregular datapoints with a sparse stretch, so some windows have too few.
+std::shared_ptr<Metric> createMetric() {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<app::time> gap(1, 90);
+  vector<app::time> times;
+  vector<app::value> values;
+  app::time t = TIME_BEGIN;
+  for (size_t i = 0; i < 200; i++) {
+    t += i >= 100 && i < 110 ? 3000 : gap(generator);
+    times.push_back(t);
+    values.push_back(std::sin(i * 0.3) * 10 + i % 5);
+  }
+  return std::make_shared<Metric>("metric.0", MetricData(std::move(times), std::move(values)), 0);
+}
+
+template <class INTERPOLATION>
+app::PatternStatus tryGetPattern(const std::shared_ptr<Metric>& metric, app::time tBegin, app::time tEnd) {
+  PlotPattern<app::PATTERN_SIZE> pattern;
+  return Metric::tryGetPattern<app::PATTERN_SIZE, INTERPOLATION>(metric, tBegin, tEnd, pattern);
+}
+
+}  // namespace
+
+SCENARIO("WindowCursor locates windows as Metric does.") {
+  auto metric = createMetric();
+  const MetricData& data = metric->getData();
+  Metric::WindowCursor cursor(metric);
+
+  GIVEN("Windows moving forward, then backward, through the metric.") {
+    vector<app::time> windowBegins;
+    for (app::time t = metric->getTimeBegin(); t + 600 <= metric->getTimeEnd(); t += 37) {
+      windowBegins.push_back(t);
+    }
+    for (size_t i = windowBegins.size(); i-- > 0;) {
+      windowBegins.push_back(windowBegins[i] + 11);
+    }
+
+    THEN("Each seek gives Metric::getIndexAfter and Metric::getIndexBefore.") {
+      for (app::time tBegin : windowBegins) {
+        app::time tEnd = tBegin + 600;
+        REQUIRE(cursor.trySeek(tBegin, tEnd) == app::PatternStatus::OK);
+        REQUIRE(cursor.getIndexAfter() == metric->getIndexAfter(tBegin));
+        REQUIRE(cursor.getIndexBefore() == metric->getIndexBefore(tEnd));
+      }
+    }
+  }
+
+  GIVEN("Windows before the first and after the last datapoint.") {
+    THEN("They are rejected, and the cursor stays where it was.") {
+      REQUIRE(cursor.trySeek(data.timeAt(10), data.timeAt(20)) == app::PatternStatus::OK);
+      REQUIRE(cursor.trySeek(TIME_BEGIN - 1000, TIME_BEGIN - 1) == app::PatternStatus::BEFORE_METRIC_BEGIN);
+      REQUIRE(cursor.trySeek(metric->getTimeEnd() + 1, metric->getTimeEnd() + 1000) ==
+          app::PatternStatus::AFTER_METRIC_END);
+      REQUIRE(cursor.getIndexAfter() == 10);
+      REQUIRE(cursor.getIndexBefore() == 20);
+      REQUIRE_THROWS_AS(cursor.seek(TIME_BEGIN - 1000, TIME_BEGIN - 1), const char*);
+    }
+  }
+}
+
+SCENARIO("The interpolation policies reject the same windows.") {
+  auto metric = createMetric();
+
+  GIVEN("Windows sliding over and past the metric, some over its sparse stretch.") {
+    THEN("Every policy returns the same status, and every status occurs.") {
+      size_t statusCounts[static_cast<size_t>(app::PatternStatus::COUNT)] = {};
+      for (app::time duration : {120, 600, 2400}) {
+        for (app::time tBegin = TIME_BEGIN - 3000; tBegin < metric->getTimeEnd() + 3000; tBegin += 53) {
+          app::time tEnd = tBegin + duration;
+          auto status = tryGetPattern<LinearInterpolation>(metric, tBegin, tEnd);
+          REQUIRE(tryGetPattern<CatmullRomInterpolation>(metric, tBegin, tEnd) == status);
+          REQUIRE(tryGetPattern<SplineInterpolation>(metric, tBegin, tEnd) == status);
+          REQUIRE(tryGetPattern<MetricSplineInterpolation>(metric, tBegin, tEnd) == status);
+          statusCounts[static_cast<size_t>(status)]++;
+        }
+      }
+      for (size_t count : statusCounts) {
+        REQUIRE(count > 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,171 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "metric.h"
+#include "model-store.h"
+#include "q-model.h"
+#include "tile-coding.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char* MODEL_FILE = "model-store-test.model";
+const char* CORRUPT_FILE = "model-store-test-corrupt.model";
+const size_t TABLE_SIZE = 1 << 12;
+
+vector<std::shared_ptr<Metric>> createMetrics() {
+  vector<std::shared_ptr<Metric>> metrics;
+  for (size_t m = 0; m < 3; m++) {
+    metrics.push_back(std::make_shared<Metric>(
+        "metric." + std::to_string(m), MetricData(vector<app::time>({100, 160}), vector<app::value>({1, 2})), m));
+  }
+  return metrics;
+}
+
+// A state of each metric: 10 normalized y values, then the metric index.
+vector<rl::floatVector> createStates() {
+  vector<rl::floatVector> states;
+  for (size_t m = 0; m < 3; m++) {
+    for (size_t s = 0; s < 20; s++) {
+      rl::floatVector state;
+      for (size_t i = 0; i < app::PATTERN_SIZE; i++) {
+        state.push_back(static_cast<float>((s * 7 + i * 3) % 11) / 10);
+      }
+      state.push_back(static_cast<float>(m));
+      states.push_back(state);
+    }
+  }
+  return states;
+}
+
+void train(QModel &model, const rl::coding::TileCode &tileCode) {
+  auto states = createStates();
+  model.reserveIncrements(states.size() * tileCode.getNumTilings());
+  for (size_t s = 0; s < states.size(); s++) {
+    model.update(states[s], *app::goalAction, -static_cast<rl::FLOAT>(s), states[(s + 1) % states.size()]);
+  }
+}
+
+vector<char> readFile(const string& fileName) {
+  std::ifstream stream(fileName, std::ios::binary);
+  return vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const string& fileName, const vector<char>& bytes) {
+  std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+  stream.write(bytes.data(), bytes.size());
+}
+
+template <class T>
+void patch(vector<char>& bytes, size_t offset, T value) {
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+}  // namespace
+
+SCENARIO("ModelStore round trips a trained model.") {
+  auto metrics = createMetrics();
+  size_t metricDimension = app::getMetricDimension(metrics);
+
+  for (auto coder : {app::TileCoder::PATTERN, app::TileCoder::MURMUR}) {
+    for (auto storage : {QModel::Storage::DENSE, QModel::Storage::SPARSE, QModel::Storage::HALF}) {
+      GIVEN("A trained " + app::getTileCoderName(coder) + " model, storage " +
+            std::to_string(static_cast<int>(storage)) + ".") {
+        auto tileCode = app::createTileCode(metricDimension, TABLE_SIZE, coder);
+        QModel model(*tileCode, 0.1F, 0.9F, -100.0F, storage, 64);
+        train(model, *tileCode);
+
+        WHEN("It is written and opened.") {
+          ModelStore::write(MODEL_FILE, model, metrics);
+          auto store = ModelStore::open(MODEL_FILE);
+
+          THEN("Every metric is found, and every state-action has the same value.") {
+            REQUIRE(store->getMetricCount() == metrics.size());
+            for (const auto& metric : metrics) {
+              size_t metricIndex;
+              REQUIRE(store->findMetricIndex(metric->getMetricName(), metricIndex));
+              REQUIRE(metricIndex == metric->getMetricIndex());
+            }
+            size_t metricIndex;
+            REQUIRE_FALSE(store->findMetricIndex("metric.missing", metricIndex));
+
+            for (const auto& state : createStates()) {
+              REQUIRE(store->getValue(state, *app::goalAction) == model.getValue(state, *app::goalAction));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  GIVEN("A valid model's bytes.") {
+    auto tileCode = app::createTileCode(metricDimension, TABLE_SIZE);
+    QModel model(*tileCode, 0.1F, 0.9F, -100.0F, QModel::Storage::SPARSE, 64);
+    train(model, *tileCode);
+    ModelStore::write(MODEL_FILE, model, metrics);
+    auto bytes = readFile(MODEL_FILE);
+    size_t entryOffset = sizeof(ModelStore::Header);
+
+    THEN("Every truncation is rejected.") {
+      for (size_t size = 0; size < bytes.size(); size += 8) {
+        writeFile(CORRUPT_FILE, vector<char>(bytes.begin(), bytes.begin() + size));
+        REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+      }
+    }
+
+    THEN("Older versions and foreign files are rejected.") {
+      auto older = bytes;
+      patch<uint32_t>(older, offsetof(ModelStore::Header, version), ModelStore::VERSION - 1);
+      writeFile(CORRUPT_FILE, older);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      writeFile(CORRUPT_FILE, vector<char>(256, 'x'));
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+      REQUIRE_THROWS_AS(ModelStore::open("model-store-test-missing.model"), const std::runtime_error&);
+    }
+
+    THEN("Counts and offsets that overflow past the checks are rejected.") {
+      // Wraps indexOffset + sizeof(IndexEntry) * metricCount around to indexOffset.
+      auto metricCount = bytes;
+      patch<uint64_t>(metricCount, offsetof(ModelStore::Header, metricCount), 1ULL << 60);
+      writeFile(CORRUPT_FILE, metricCount);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      // Wraps the key and weight columns' ends around.
+      auto weightCount = bytes;
+      patch<uint64_t>(weightCount, offsetof(ModelStore::Header, weightCount), 1ULL << 62);
+      writeFile(CORRUPT_FILE, weightCount);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      // nameOffset + nameLength wraps around to a small number.
+      auto name = bytes;
+      patch<uint64_t>(name, entryOffset + offsetof(ModelStore::IndexEntry, nameOffset), ~0ULL);
+      patch<uint64_t>(name, entryOffset + offsetof(ModelStore::IndexEntry, nameLength), 2);
+      writeFile(CORRUPT_FILE, name);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto tileCoder = bytes;
+      patch<uint32_t>(tileCoder, offsetof(ModelStore::Header, tileCoder), 7);
+      writeFile(CORRUPT_FILE, tileCoder);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+
+      auto modelSize = bytes;
+      patch<uint64_t>(modelSize, offsetof(ModelStore::Header, modelSize), TABLE_SIZE + 1);
+      writeFile(CORRUPT_FILE, modelSize);
+      REQUIRE_THROWS_AS(ModelStore::open(CORRUPT_FILE), const std::runtime_error&);
+    }
+  }
+}
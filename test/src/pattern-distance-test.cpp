@@ -0,0 +1,82 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "catch.hpp"
+#include "pattern-distance.h"
+
+using std::vector;
+
+namespace {
+
+// count patterns of the given resolution, zero padded as PatternDistance expects.
+vector<float> createPatterns(std::mt19937& generator, size_t count, size_t resolution) {
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  size_t size = PatternDistance::paddedSize(resolution);
+  vector<float> patterns(count * size, 0.0f);
+  for (size_t c = 0; c < count; c++) {
+    for (size_t i = 0; i < resolution; i++) {
+      patterns[c * size + i] = value(generator);
+    }
+  }
+  return patterns;
+}
+
+// Differs from the scalar kernel by summation order only.
+void requireClose(const vector<float>& actual, const vector<float>& expected) {
+  REQUIRE(actual.size() == expected.size());
+  for (size_t c = 0; c < actual.size(); c++) {
+    REQUIRE(std::abs(actual[c] - expected[c]) <= 1e-5f * (1.0f + std::abs(expected[c])));
+  }
+}
+
+}  // namespace
+
+SCENARIO("Every supported PatternDistance kernel gives the scalar kernel's distances.") {
+  std::mt19937 generator(42);
+  vector<PatternDistance::Kernel> kernels;
+  for (auto kernel : {PatternDistance::Kernel::SSE2, PatternDistance::Kernel::AVX}) {
+    if (PatternDistance::isSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+
+  GIVEN("Resolutions that are not a multiple of the lanes, and odd candidate counts.") {
+    THEN("Distances are the same for every candidate, and the default is the best kernel.") {
+      REQUIRE(PatternDistance::isSupported(PatternDistance::Kernel::SCALAR));
+      REQUIRE(PatternDistance::isSupported(PatternDistance::getBestKernel()));
+
+      for (size_t resolution : {1, 3, 4, 7, 8, 9, 13, 31, 61, 64}) {
+        for (size_t count : {1, 3, 4, 5, 7, 8, 9, 17}) {
+          auto goal = createPatterns(generator, 1, resolution);
+          auto candidates = createPatterns(generator, count, resolution);
+
+          vector<float> expectedAbsolute(count);
+          vector<float> expected(count);
+          PatternDistance::absoluteArea(PatternDistance::Kernel::SCALAR,
+                                        goal.data(), candidates.data(), count, resolution, expectedAbsolute.data());
+          PatternDistance::area(PatternDistance::Kernel::SCALAR,
+                                goal.data(), candidates.data(), count, resolution, expected.data());
+
+          for (auto kernel : kernels) {
+            vector<float> actual(count);
+            PatternDistance::absoluteArea(kernel, goal.data(), candidates.data(), count, resolution, actual.data());
+            requireClose(actual, expectedAbsolute);
+            PatternDistance::area(kernel, goal.data(), candidates.data(), count, resolution, actual.data());
+            requireClose(actual, expected);
+          }
+
+          vector<float> actual(count);
+          PatternDistance::absoluteArea(goal.data(), candidates.data(), count, resolution, actual.data());
+          requireClose(actual, expectedAbsolute);
+          PatternDistance::area(goal.data(), candidates.data(), count, resolution, actual.data());
+          requireClose(actual, expected);
+        }
+      }
+    }
+  }
+}
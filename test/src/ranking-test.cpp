@@ -0,0 +1,52 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cmath>
+#include <vector>
+
+#include "catch.hpp"
+#include "ranking.h"
+
+using std::vector;
+
+SCENARIO("Ranking compares the top of two scores.") {
+  GIVEN("Scores with ties.") {
+    vector<rl::FLOAT> values({1, 3, 3, 2});
+
+    THEN("getTop orders them highest first, ties by index.") {
+      REQUIRE(Ranking::getTop(values, 3) == vector<size_t>({1, 2, 3}));
+      REQUIRE(Ranking::getTop(values, 10) == vector<size_t>({1, 2, 3, 0}));
+      REQUIRE(Ranking::getTop(values, 0).empty());
+      REQUIRE(Ranking::getTop(vector<rl::FLOAT>(), 5).empty());
+    }
+  }
+
+  GIVEN("A reference and values that both have ties.") {
+    vector<rl::FLOAT> reference({4, 3, 3, 1});
+    vector<rl::FLOAT> values({3, 2, 1, 1});
+
+    THEN("Kendall's tau-b matches the hand computed value.") {
+      // Pairs of the top 4: (0,1) (0,2) (0,3) (1,3) concordant, (1,2) tied in the
+      // reference only, (2,3) tied in the values only.
+      // tau-b = (4 - 0) / sqrt((4 + 0 + 1) * (4 + 0 + 1)) = 0.8.
+      REQUIRE(Ranking::getKendallTau(reference, values, 4) == Approx(0.8));
+
+      // Top 3: (0,1) (0,2) concordant, (1,2) tied in the reference only.
+      // tau-b = 2 / sqrt((2 + 1) * 2).
+      REQUIRE(Ranking::getKendallTau(reference, values, 3) == Approx(2 / std::sqrt(6.0)));
+    }
+
+    THEN("Pairs tied in both are left out, constant scores give 0.") {
+      REQUIRE(Ranking::getKendallTau({2, 1, 1}, {2, 1, 1}, 3) == Approx(1));
+      REQUIRE(Ranking::getKendallTau({1, 2, 3}, {3, 2, 1}, 3) == Approx(-1));
+      REQUIRE(Ranking::getKendallTau({1, 1, 1}, {1, 2, 3}, 3) == 0);
+    }
+
+    THEN("getTopOverlap counts the shared top metrics.") {
+      REQUIRE(Ranking::getTopOverlap(reference, values, 2) == Approx(1));
+      REQUIRE(Ranking::getTopOverlap({4, 3, 2, 1}, {1, 2, 3, 4}, 2) == 0);
+      REQUIRE(Ranking::getTopOverlap({4, 3, 2, 1}, {4, 1, 3, 2}, 2) == Approx(0.5));
+    }
+  }
+}
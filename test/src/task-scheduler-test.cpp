@@ -0,0 +1,139 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "catch.hpp"
+#include "task-scheduler.h"
+
+using std::vector;
+
+SCENARIO("TaskScheduler runs ranges on its workers.") {
+  GIVEN("A pool of 4 workers.") {
+    TaskScheduler scheduler(4);
+    REQUIRE(scheduler.getWorkerCount() == 4);
+
+    THEN("parallelFor runs every index exactly once, whatever the grain size.") {
+      for (size_t count : {1, 7, 64, 1000}) {
+        for (size_t grainSize : {1, 3, 64, 5000}) {
+          // Catch's assertions aren't thread safe, tasks only record.
+          vector<std::atomic<int>> runs(count);
+          for (auto& r : runs) {
+            r.store(0);
+          }
+          std::atomic<bool> isOutOfRange(false);
+          scheduler.parallelFor(count, grainSize, [&](size_t begin, size_t end) {
+            if (begin >= end || end > count) {
+              isOutOfRange = true;
+              return;
+            }
+            for (size_t i = begin; i < end; i++) {
+              runs[i]++;
+            }
+          });
+          REQUIRE_FALSE(isOutOfRange.load());
+          for (size_t i = 0; i < count; i++) {
+            REQUIRE(runs[i].load() == 1);
+          }
+        }
+      }
+    }
+
+    THEN("An empty range runs nothing.") {
+      bool ran = false;
+      scheduler.parallelFor(0, 1, [&](size_t, size_t) { ran = true; });
+      REQUIRE_FALSE(ran);
+    }
+
+    THEN("The pool is reused across jobs.") {
+      std::atomic<size_t> sum(0);
+      for (size_t job = 0; job < 200; job++) {
+        scheduler.parallelFor(100, 7, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            sum += i;
+          }
+        });
+      }
+      REQUIRE(sum.load() == 200 * 4950);
+
+      size_t taskCount = 0;
+      for (const auto& stats : scheduler.getStats()) {
+        taskCount += stats.taskCount;
+      }
+      REQUIRE(taskCount == 200 * 15);
+    }
+
+    WHEN("A task throws.") {
+      std::atomic<size_t> calls(0);
+      auto throwing = [&](size_t begin, size_t) {
+        calls++;
+        if (begin == 0) {
+          throw std::domain_error("Chunk 0 failed.");
+        }
+      };
+
+      THEN("parallelFor rethrows it, having run only the chunks already started.") {
+        REQUIRE_THROWS_AS(scheduler.parallelFor(64, 1, throwing), const std::domain_error&);
+        REQUIRE(calls.load() >= 1);
+
+        size_t taskCount = 0;
+        for (const auto& stats : scheduler.getStats()) {
+          taskCount += stats.taskCount;
+        }
+        REQUIRE(taskCount == calls.load());
+      }
+
+      THEN("The next job runs every index again.") {
+        REQUIRE_THROWS_AS(scheduler.parallelFor(64, 1, throwing), const std::domain_error&);
+        vector<std::atomic<int>> runs(64);
+        for (auto& r : runs) {
+          r.store(0);
+        }
+        scheduler.parallelFor(64, 1, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            runs[i]++;
+          }
+        });
+        for (size_t i = 0; i < runs.size(); i++) {
+          REQUIRE(runs[i].load() == 1);
+        }
+      }
+    }
+  }
+
+  GIVEN("A pool of 1 worker, whose first chunk throws.") {
+    TaskScheduler scheduler(1);
+    size_t calls = 0;
+    auto throwing = [&](size_t begin, size_t) {
+      calls++;
+      if (begin == 0) {
+        throw std::domain_error("Chunk 0 failed.");
+      }
+    };
+
+    THEN("The remaining chunks are drained without running them.") {
+      REQUIRE_THROWS_AS(scheduler.parallelFor(64, 1, throwing), const std::domain_error&);
+      REQUIRE(calls == 1);
+      REQUIRE(scheduler.getStats()[0].taskCount == 1);
+
+      // The deque was emptied, the next job starts from its own chunks.
+      size_t covered = 0;
+      scheduler.parallelFor(10, 3, [&](size_t begin, size_t end) { covered += end - begin; });
+      REQUIRE(covered == 10);
+    }
+  }
+
+  GIVEN("A pool asked for no workers.") {
+    TaskScheduler scheduler(0);
+
+    THEN("It has one worker, which runs everything.") {
+      REQUIRE(scheduler.getWorkerCount() == 1);
+      size_t covered = 0;
+      scheduler.parallelFor(10, 3, [&](size_t begin, size_t end) { covered += end - begin; });
+      REQUIRE(covered == 10);
+    }
+  }
+}
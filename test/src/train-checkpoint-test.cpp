@@ -0,0 +1,160 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "q-model.h"
+#include "tile-coding.h"
+#include "train-checkpoint.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char* CHECKPOINT_FILE = "train-checkpoint-test.ckpt";
+const char* CORRUPT_FILE = "train-checkpoint-test-corrupt.ckpt";
+const size_t METRIC_DIMENSION = 3;
+const size_t TABLE_SIZE = 1 << 12;
+
+// Weights spread over the table, the last one set back to the initial weight.
+void train(QModel &model) {
+  for (size_t w = 0; w < model.getSize(); w += 97) {
+    model.setWeight(w, static_cast<rl::FLOAT>(w) / 64 - 20);
+  }
+  model.setWeight(97, model.getInitialWeight());
+}
+
+void requireSameWeights(const QModel &a, const QModel &b) {
+  REQUIRE(a.getSize() == b.getSize());
+  for (size_t w = 0; w < a.getSize(); w++) {
+    REQUIRE(a.getWeight(w) == b.getWeight(w));
+  }
+}
+
+TrainCheckpoint createCheckpoint(const QModel &model) {
+  TrainCheckpoint checkpoint;
+  checkpoint.seed = 42;
+  checkpoint.sampler = app::Sampler::SOBOL;
+  checkpoint.iterationCount = 1000;
+  checkpoint.iterationsDone = 300;
+  checkpoint.round = 1;
+  checkpoint.metricCount = METRIC_DIMENSION;
+  checkpoint.activeMetrics = {0, 2};
+  checkpoint.capture(model);
+  return checkpoint;
+}
+
+vector<char> readFile(const string& fileName) {
+  std::ifstream stream(fileName, std::ios::binary);
+  return vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const string& fileName, const vector<char>& bytes) {
+  std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+  stream.write(bytes.data(), bytes.size());
+}
+
+}  // namespace
+
+SCENARIO("TrainCheckpoint round trips the training state.") {
+  auto tileCode = app::createTileCode(METRIC_DIMENSION, TABLE_SIZE);
+
+  for (auto storage : {QModel::Storage::DENSE, QModel::Storage::SPARSE, QModel::Storage::HALF}) {
+    GIVEN("A trained model, storage " + std::to_string(static_cast<int>(storage)) + ".") {
+      QModel model(*tileCode, 0.1F, 0.9F, -100.0F, storage, 64);
+      train(model);
+
+      WHEN("Its checkpoint is written, read, and restored into a fresh model.") {
+        createCheckpoint(model).write(CHECKPOINT_FILE);
+        auto checkpoint = TrainCheckpoint::read(CHECKPOINT_FILE);
+        QModel restored(*tileCode, 0.1F, 0.9F, -100.0F, storage, 64);
+        restored.setWeight(1, 5);
+        checkpoint.restore(restored);
+
+        THEN("The model and the training state are the same.") {
+          requireSameWeights(model, restored);
+          REQUIRE(checkpoint.seed == 42);
+          REQUIRE(checkpoint.sampler == app::Sampler::SOBOL);
+          REQUIRE(checkpoint.iterationCount == 1000);
+          REQUIRE(checkpoint.iterationsDone == 300);
+          REQUIRE(checkpoint.round == 1);
+          REQUIRE(checkpoint.metricCount == METRIC_DIMENSION);
+          REQUIRE(checkpoint.activeMetrics == vector<size_t>({0, 2}));
+        }
+      }
+
+      WHEN("A captured checkpoint is restored without being written.") {
+        auto checkpoint = createCheckpoint(model);
+        train(model);
+        model.setWeight(3, 1);
+        checkpoint.restore(model);
+
+        THEN("The model is back to the captured weights.") {
+          QModel expected(*tileCode, 0.1F, 0.9F, -100.0F, storage, 64);
+          train(expected);
+          requireSameWeights(expected, model);
+        }
+      }
+
+      WHEN("It is written by a CheckpointWriter.") {
+        {
+          CheckpointWriter writer(CHECKPOINT_FILE);
+          writer.write(createCheckpoint(model));
+          writer.wait();
+        }
+
+        THEN("The file restores the model.") {
+          QModel restored(*tileCode, 0.1F, 0.9F, -100.0F, storage, 64);
+          TrainCheckpoint::read(CHECKPOINT_FILE).restore(restored);
+          requireSameWeights(model, restored);
+        }
+      }
+    }
+  }
+
+  GIVEN("A checkpoint of a dense model.") {
+    QModel model(*tileCode, 0.1F, 0.9F, -100.0F);
+    train(model);
+    createCheckpoint(model).write(CHECKPOINT_FILE);
+    auto bytes = readFile(CHECKPOINT_FILE);
+
+    THEN("Models of another size or tile coder are refused.") {
+      auto checkpoint = TrainCheckpoint::read(CHECKPOINT_FILE);
+      auto otherTileCode = app::createTileCode(METRIC_DIMENSION, TABLE_SIZE * 2);
+      QModel otherSize(*otherTileCode, 0.1F, 0.9F, -100.0F);
+      REQUIRE_THROWS_AS(checkpoint.restore(otherSize), const std::runtime_error&);
+
+      auto pattern = app::createTileCode(METRIC_DIMENSION, TABLE_SIZE, app::TileCoder::PATTERN);
+      QModel otherCoder(*pattern, 0.1F, 0.9F, -100.0F);
+      REQUIRE(otherCoder.getTileCoder() == app::TileCoder::PATTERN);
+      REQUIRE_THROWS_AS(checkpoint.restore(otherCoder), const std::runtime_error&);
+    }
+
+    THEN("Truncated, older and foreign files are refused.") {
+      for (size_t size = 0; size < bytes.size(); size += 8) {
+        writeFile(CORRUPT_FILE, vector<char>(bytes.begin(), bytes.begin() + size));
+        REQUIRE_THROWS_AS(TrainCheckpoint::read(CORRUPT_FILE), const std::runtime_error&);
+      }
+
+      auto older = bytes;
+      uint32_t version = TrainCheckpoint::VERSION - 1;
+      std::memcpy(older.data() + offsetof(TrainCheckpoint::Header, version), &version, sizeof(version));
+      writeFile(CORRUPT_FILE, older);
+      REQUIRE_THROWS_AS(TrainCheckpoint::read(CORRUPT_FILE), const std::runtime_error&);
+
+      writeFile(CORRUPT_FILE, vector<char>(256, 'x'));
+      REQUIRE_THROWS_AS(TrainCheckpoint::read(CORRUPT_FILE), const std::runtime_error&);
+      REQUIRE_THROWS_AS(TrainCheckpoint::read("train-checkpoint-test-missing.ckpt"), const std::runtime_error&);
+    }
+  }
+}
@@ -0,0 +1,317 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "allocation-counter.h"
+#include "app.h"
+#include "metric.h"
+#include "q-model.h"
+#include "ranking.h"
+#include "task-scheduler.h"
+#include "tile-coding.h"
+
+using std::vector;
+
+namespace {
+
+const app::time TIME_BEGIN = 1474100000;
+const app::time STEP = 60;
+const size_t POINT_COUNT = 240;
+const size_t METRIC_COUNT = 8;
+
+// Random walks, so patterns differ from metric to metric and window to window.
+vector<std::shared_ptr<Metric>> createMetrics() {
+  std::mt19937 generator(42);
+  std::normal_distribution<double> step(0.0, 1.0);
+  vector<std::shared_ptr<Metric>> metrics;
+  for (size_t m = 0; m < METRIC_COUNT; m++) {
+    vector<app::time> times(POINT_COUNT);
+    vector<app::value> values(POINT_COUNT);
+    double value = 0;
+    for (size_t i = 0; i < POINT_COUNT; i++) {
+      times[i] = TIME_BEGIN + i * STEP;
+      value += step(generator);
+      values[i] = value;
+    }
+    metrics.push_back(std::make_shared<Metric>(
+        "metric." + std::to_string(m), MetricData(std::move(times), std::move(values)), m));
+  }
+  return metrics;
+}
+
+const app::time GOAL_TIME_BEGIN = TIME_BEGIN + 60 * STEP;
+const app::time GOAL_TIME_END = TIME_BEGIN + 90 * STEP;
+
+// app::train, of a QModel or rl's agent, with its progress output discarded.
+template <class MODEL>
+app::TrainSummary train(const vector<std::shared_ptr<Metric>> &metrics,
+                        MODEL &model,
+                        const app::TrainOptions &options) {
+  auto goalState = Metric::getPattern<app::PATTERN_SIZE>(metrics[0], GOAL_TIME_BEGIN, GOAL_TIME_END);
+  auto minMaxTime = Metric::getMinMaxTime(metrics);
+  // Without a buffer, which would allocate as the output grows.
+  auto coutBuffer = std::cout.rdbuf(nullptr);
+  auto summary = app::train(100, metrics, goalState, model, minMaxTime.first, minMaxTime.second, options);
+  std::cout.rdbuf(coutBuffer);
+  return summary;
+}
+
+}  // namespace
+
+// Hidden: allocations are only counted with COUNT_ALLOCATIONS defined, so it is run
+// by allocationTestExecutable (see test/CMakeLists.txt), and fails elsewhere.
+SCENARIO("Training a QModel doesn't allocate after its first window.", "[.][allocations]") {
+  size_t allocationCount = app::getAllocationCount();
+  std::unique_ptr<int> allocated(new int(0));
+  REQUIRE(app::getAllocationCount() > allocationCount);
+
+  auto metrics = createMetrics();
+  size_t metricDimension = app::getMetricDimension(metrics);
+  auto tileCode = app::createTileCode(
+      metricDimension, app::getTableSize(metricDimension, 64), app::TileCoder::PATTERN);
+
+  for (auto storage : {QModel::Storage::DENSE, QModel::Storage::HALF}) {
+    for (size_t threadCount : {0, 1, 3}) {
+      GIVEN("Storage " + std::to_string(static_cast<int>(storage)) + ", " +
+            std::to_string(threadCount) + " worker thread(s).") {
+        std::unique_ptr<TaskScheduler> scheduler(threadCount > 0 ? new TaskScheduler(threadCount) : nullptr);
+        app::TrainOptions options;
+        options.interpolation = app::Interpolation::LINEAR;
+        options.scheduler = scheduler.get();
+        options.seed = 42;
+        QModel model(*tileCode, 0.1F, 0.9F, -100.0F, storage);
+
+        auto summary = train(metrics, model, options);
+
+        THEN("Every window trained the metrics without allocating.") {
+          REQUIRE(summary.updateCount > 0);
+          REQUIRE(summary.steadyStateAllocations == 0);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("The qLearningGD and td0 learners rank the metrics alike.") {
+  auto metrics = createMetrics();
+  size_t metricDimension = app::getMetricDimension(metrics);
+  auto tileCode = app::createTileCode(
+      metricDimension, app::getTableSize(metricDimension, 64), app::TileCoder::MURMUR);
+  app::TrainOptions options;
+  options.interpolation = app::Interpolation::LINEAR;
+  options.seed = 42;
+
+  GIVEN("Both learners trained on one thread, on the same windows.") {
+    QModel model(*tileCode, 0.1F, 0.9F, -100.0F);
+    auto td0Summary = train(metrics, model, options);
+
+    rl::policy::EpsilonGreedy<rl::floatVector, rl::floatVector> policy(1.0F);
+    rl::algorithm::QLearningGD qLearning(*tileCode, 0.1F, 0.9F, app::TRACE_DECAY, policy);
+    qLearning.setDefaultStateActionValue(-100.0F);
+    rl::AgentSupervised<rl::floatVector, rl::floatVector> agent(
+        rl::ActionSet<rl::floatVector>(rl::spActionSet<rl::floatVector>({app::goalAction})), qLearning);
+    auto qLearningGDSummary = train(metrics, agent, options);
+
+    auto patterns = Metric::getPatternsFromMetrics<app::PATTERN_SIZE>(
+        metrics, GOAL_TIME_BEGIN, GOAL_TIME_END, app::Interpolation::LINEAR);
+    auto td0Scores = app::score(patterns, model);
+    auto qLearningGDScores = app::score(patterns, qLearning);
+
+    THEN("They made the same updates, and their rankings differ by at most the traces' effect.") {
+      REQUIRE(td0Summary.updateCount == qLearningGDSummary.updateCount);
+      REQUIRE(td0Scores.size() == METRIC_COUNT);
+      // The traces also apply each update's error to the metrics updated before it,
+      // so the values differ, and only the order is required to mostly agree.
+      REQUIRE(Ranking::getKendallTau(qLearningGDScores, td0Scores, METRIC_COUNT) >= 0.5);
+      REQUIRE(Ranking::getTopOverlap(qLearningGDScores, td0Scores, METRIC_COUNT / 2) >= 0.5);
+    }
+  }
+}
+
+SCENARIO("Early stopping stops once the ranking stayed stable for the patience.") {
+  auto metrics = createMetrics();
+  size_t metricDimension = app::getMetricDimension(metrics);
+  auto tileCode = app::createTileCode(
+      metricDimension, app::getTableSize(metricDimension, 64), app::TileCoder::PATTERN);
+  auto patterns = Metric::getPatternsFromMetrics<app::PATTERN_SIZE>(
+      metrics, GOAL_TIME_BEGIN, GOAL_TIME_END, app::Interpolation::LINEAR);
+
+  for (double threshold : {-1.0, 0.9, 1.1}) {
+    GIVEN("Checkpoints every 10 of 100 iterations, threshold " + std::to_string(threshold) + ", patience 2.") {
+      QModel model(*tileCode, 0.1F, 0.9F, -100.0F);
+      app::TrainOptions options;
+      options.interpolation = app::Interpolation::LINEAR;
+      options.seed = 42;
+      options.earlyStopping.patterns = &patterns;
+      options.earlyStopping.checkpointInterval = 10;
+      options.earlyStopping.topK = METRIC_COUNT;
+      options.earlyStopping.threshold = threshold;
+      options.earlyStopping.patience = 2;
+
+      // The Kendall tau of each checkpoint, computed again from the same scores.
+      vector<size_t> checkpoints;
+      vector<double> taus;
+      auto previousValues = app::score(patterns, model);
+      options.checkpoint = [&](size_t iterationsDone) {
+        auto values = app::score(patterns, model);
+        checkpoints.push_back(iterationsDone);
+        taus.push_back(Ranking::getKendallTau(values, previousValues, METRIC_COUNT));
+        previousValues.swap(values);
+        return true;
+      };
+
+      auto summary = train(metrics, model, options);
+
+      THEN("Training stops at the first checkpoint 2 in a row reached the threshold, if any.") {
+        size_t expectedIterations = 100;
+        for (size_t c = 1; c < taus.size(); c++) {
+          if (taus[c - 1] >= threshold && taus[c] >= threshold) {
+            expectedIterations = checkpoints[c];
+            break;
+          }
+        }
+        REQUIRE(checkpoints.back() == summary.iterations);
+        REQUIRE(summary.iterations == expectedIterations);
+        REQUIRE(summary.stoppedEarly == (expectedIterations < 100));
+        if (threshold < 0) {
+          REQUIRE(summary.iterations == 20);  // Every tau is at least -1.
+        } else if (threshold > 1) {
+          REQUIRE(summary.iterations == 100);
+        } else {
+          // Some checkpoints were below the threshold before it stopped.
+          REQUIRE(summary.iterations > 20);
+          REQUIRE(summary.stoppedEarly);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Successive halving keeps training the best valued metrics.") {
+  auto metrics = createMetrics();
+  size_t metricDimension = app::getMetricDimension(metrics);
+  auto tileCode = app::createTileCode(
+      metricDimension, app::getTableSize(metricDimension, 64), app::TileCoder::PATTERN);
+  auto patterns = Metric::getPatternsFromMetrics<app::PATTERN_SIZE>(
+      metrics, GOAL_TIME_BEGIN, GOAL_TIME_END, app::Interpolation::LINEAR);
+  QModel model(*tileCode, 0.1F, 0.9F, -100.0F);
+  app::TrainOptions options;
+  options.interpolation = app::Interpolation::LINEAR;
+  options.seed = 42;
+
+  GIVEN("4 rounds of 25 iterations, keeping half of the metrics but at least 3.") {
+    options.successiveHalving.rounds = 4;
+    options.successiveHalving.keepFraction = 0.5;
+    options.successiveHalving.minMetrics = 3;
+
+    // At the end of each round, the metrics the next one should keep: the best
+    // valued over the goal pattern's time frame, among the ones still trained.
+    vector<size_t> expectedActive({0, 1, 2, 3, 4, 5, 6, 7});
+    vector<size_t> activeCounts;
+    options.checkpointInterval = 25;
+    options.checkpoint = [&](size_t iterationsDone) {
+      activeCounts.push_back(expectedActive.size());
+      if (iterationsDone == 100) {
+        return true;
+      }
+      auto scores = app::score(patterns, model);
+      vector<rl::FLOAT> values;
+      for (size_t m : expectedActive) {
+        values.push_back(scores[m]);
+      }
+      size_t keepCount = std::max<size_t>(3, (expectedActive.size() + 1) / 2);
+      vector<size_t> kept;
+      for (size_t k : Ranking::getTop(values, keepCount)) {
+        kept.push_back(expectedActive[k]);
+      }
+      std::sort(kept.begin(), kept.end());
+      expectedActive.swap(kept);
+      return true;
+    };
+
+    auto summary = train(metrics, model, options);
+
+    THEN("Each round trains the metrics the previous one valued best.") {
+      REQUIRE(activeCounts == vector<size_t>({8, 4, 3, 3}));
+      REQUIRE(summary.activeMetrics == expectedActive);
+      REQUIRE(summary.updateCount == 25 * (8 + 4 + 3 + 3));
+      REQUIRE(summary.iterations == 100);
+    }
+  }
+
+  GIVEN("No successive halving.") {
+    auto summary = train(metrics, model, options);
+
+    THEN("Every metric is trained on every window.") {
+      REQUIRE(summary.activeMetrics == vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7}));
+      REQUIRE(summary.updateCount == 100 * METRIC_COUNT);
+    }
+  }
+}
+
+SCENARIO("The pre-screen keeps the metrics closest to the goal metric.") {
+  // Metrics 1 and 5 follow the goal metric 3 up to scale and offset, so their
+  // normalized patterns are the goal's. Metric 7 ends before the screened time range.
+  auto metrics = createMetrics();
+  const MetricData &goalData = metrics[3]->getData();
+  for (auto copy : vector<std::pair<size_t, double>>({{1, 2.0}, {5, 0.5}})) {
+    vector<app::time> times(POINT_COUNT);
+    vector<app::value> values(POINT_COUNT);
+    for (size_t i = 0; i < POINT_COUNT; i++) {
+      times[i] = goalData.timeAt(i);
+      values[i] = goalData.valueAt(i) * copy.second + 7;
+    }
+    metrics[copy.first] = std::make_shared<Metric>(
+        "metric." + std::to_string(copy.first), MetricData(std::move(times), std::move(values)), copy.first);
+  }
+  const MetricData &earlyData = metrics[7]->getData();
+  vector<app::time> earlyTimes(POINT_COUNT);
+  vector<app::value> earlyValues(POINT_COUNT);
+  for (size_t i = 0; i < POINT_COUNT; i++) {
+    earlyTimes[i] = earlyData.timeAt(i) - POINT_COUNT * STEP * 2;
+    earlyValues[i] = earlyData.valueAt(i);
+  }
+  metrics[7] = std::make_shared<Metric>("metric.7", MetricData(std::move(earlyTimes), std::move(earlyValues)), 7);
+
+  auto goalState = Metric::getPattern<app::PATTERN_SIZE>(metrics[3], GOAL_TIME_BEGIN, GOAL_TIME_END);
+  app::time timeEnd = TIME_BEGIN + (POINT_COUNT - 1) * STEP;
+
+  for (size_t threadCount : {0, 3}) {
+    GIVEN("20 windows, screened on " + std::to_string(threadCount) + " worker thread(s).") {
+      std::unique_ptr<TaskScheduler> scheduler(threadCount > 0 ? new TaskScheduler(threadCount) : nullptr);
+      app::TrainOptions options;
+      options.interpolation = app::Interpolation::LINEAR;
+      options.scheduler = scheduler.get();
+      options.seed = 42;
+      auto screen = [&](size_t topK, double maxArea) {
+        app::ScreenOptions screenOptions;
+        screenOptions.windowCount = 20;
+        screenOptions.topK = topK;
+        screenOptions.maxArea = maxArea;
+        return app::screenMetrics(metrics, goalState, TIME_BEGIN, timeEnd, screenOptions, options);
+      };
+
+      THEN("The top k and the maximum area keep the goal metric and its copies.") {
+        REQUIRE(screen(3, -1) == vector<size_t>({1, 3, 5}));
+        REQUIRE(screen(0, 0.001) == vector<size_t>({1, 3, 5}));
+        REQUIRE(screen(3, 0.001) == vector<size_t>({1, 3, 5}));
+      }
+
+      THEN("The goal metric is always kept, and metrics without any pattern are ranked last.") {
+        auto kept = screen(1, -1);
+        REQUIRE(std::find(kept.begin(), kept.end(), 3) != kept.end());
+        REQUIRE(kept.size() <= 2);
+        REQUIRE(screen(7, -1) == vector<size_t>({0, 1, 2, 3, 4, 5, 6}));
+        REQUIRE(screen(0, -1) == vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7}));
+      }
+    }
+  }
+}
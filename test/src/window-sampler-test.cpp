@@ -0,0 +1,79 @@
+//
+// Created by agent on 17/10/26.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch.hpp"
+#include "window-sampler.h"
+
+using std::vector;
+
+SCENARIO("WindowSampler spreads the window starts over the time range.") {
+  GIVEN("Stratified samplers of several sizes.") {
+    THEN("n iterations visit each of the n strata exactly once.") {
+      app::time timeBegin = 1000;
+      for (uint64_t n : {1, 2, 3, 10, 97, 1000}) {
+        for (uint64_t range : {n, n * 3 + 1, n * 1000 + 7}) {
+          WindowSampler sampler(app::Sampler::STRATIFIED, 42, n, timeBegin, timeBegin + range - 1);
+
+          // Stratum s is [floor(range * s / n), floor(range * (s + 1) / n)).
+          vector<uint64_t> stratumBegins;
+          for (uint64_t s = 0; s <= n; s++) {
+            stratumBegins.push_back(range * s / n);
+          }
+          vector<int> visits(n, 0);
+          for (size_t i = 0; i < n; i++) {
+            uint64_t offset = sampler.getTimeBegin(i) - timeBegin;
+            REQUIRE(offset < range);
+            size_t stratum = std::upper_bound(stratumBegins.begin(), stratumBegins.end(), offset) -
+                stratumBegins.begin() - 1;
+            visits[stratum]++;
+          }
+          REQUIRE(std::count(visits.begin(), visits.end(), 1) == static_cast<long>(n));
+        }
+      }
+    }
+  }
+
+  GIVEN("Any sampler.") {
+    THEN("Starts are a pure function of the seed and the iteration.") {
+      for (auto kind : {app::Sampler::UNIFORM, app::Sampler::STRATIFIED, app::Sampler::SOBOL}) {
+        WindowSampler a(kind, 7, 100, 0, 99999);
+        WindowSampler b(kind, 7, 100, 0, 99999);
+        for (size_t i = 100; i-- > 0;) {
+          REQUIRE(a.getTimeBegin(i) == b.getTimeBegin(i));
+          REQUIRE(a.getTimeBegin(i) <= 99999);
+        }
+        REQUIRE(app::parseSampler(app::getSamplerName(kind)) == kind);
+      }
+      REQUIRE_THROWS_AS(app::parseSampler("random"), const std::domain_error&);
+    }
+  }
+
+  GIVEN("Fractions of 2^64 and ranges.") {
+    auto reference = [](uint64_t fraction, uint64_t range) {
+      return static_cast<uint64_t>((static_cast<unsigned __int128>(fraction) * range) >> 64);
+    };
+
+    THEN("scale matches the 128 bit product.") {
+      const uint64_t edges[] = {0, 1, 2, 0xffffffffULL, 0x100000000ULL, 1ULL << 63, ~0ULL - 1, ~0ULL};
+      for (uint64_t fraction : edges) {
+        for (uint64_t range : edges) {
+          REQUIRE(WindowSampler::scale(fraction, range) == reference(fraction, range));
+        }
+      }
+
+      std::mt19937_64 random(2016);
+      for (size_t i = 0; i < 100000; i++) {
+        uint64_t fraction = random();
+        uint64_t range = random() >> (random() % 64);
+        REQUIRE(WindowSampler::scale(fraction, range) == reference(fraction, range));
+      }
+    }
+  }
+}